@@ -0,0 +1,80 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+
+struct AllocationCounters {
+    uint64_t allocations = 0;
+    uint64_t deallocations = 0;
+    uint64_t bytes_allocated = 0;
+    uint64_t bytes_freed = 0;
+
+    uint64_t liveBytes() const {
+        return bytes_allocated - bytes_freed;
+    }
+
+    AllocationCounters operator-(const AllocationCounters& other) const {
+        return {
+            allocations - other.allocations,
+            deallocations - other.deallocations,
+            bytes_allocated - other.bytes_allocated,
+            bytes_freed - other.bytes_freed
+        };
+    }
+};
+
+// Heap instrumentation, compiled in with -DTRACK_ALLOCATIONS=ON. The build then replaces the global
+// operator new/delete (src/AllocationTracker.cpp) and routes ImGui through them, counting every
+// allocation per thread. One allocation in `sampling` records its callstack, which shows up in the leak
+// report. Without the option every function is an inline no-op and enabled is false.
+struct AllocationTracker {
+#ifdef TRACK_ALLOCATIONS
+    static constexpr bool enabled = true;
+
+    static AllocationCounters thread();
+    static AllocationCounters total();
+
+    // Records the callstack of every `every`-th allocation; 0 disables sampling.
+    static void setSampling(uint32_t every);
+
+    // Lists every allocation still alive; returns how many there were.
+    static size_t writeLeakReport(const char* path);
+
+    static void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    static void deallocate(void* pointer);
+#else
+    static constexpr bool enabled = false;
+
+    static AllocationCounters thread() { return {}; }
+    static AllocationCounters total() { return {}; }
+    static void setSampling(uint32_t) {}
+    static size_t writeLeakReport(const char*) { return 0; }
+    static void* allocate(size_t size, size_t = alignof(std::max_align_t)) { return std::malloc(size); }
+    static void deallocate(void* pointer) { std::free(pointer); }
+#endif
+
+    // Heap allocations made by the calling thread while `fn` runs.
+    template <typename Fn>
+    static uint64_t count(Fn&& fn) {
+        const auto before = thread();
+        fn();
+        return (thread() - before).allocations;
+    }
+
+    // Runs `fn` once per frame for `frames` frames and aborts if any of them touched the heap. Meant for
+    // checking that a warmed-up frame loop stays allocation-free, e.g. with [&] { app.runFrame(); }.
+    template <typename Fn>
+    static void assertNoAllocations(size_t frames, Fn&& fn) {
+        if constexpr (enabled) {
+            for (size_t frame = 0; frame < frames; ++frame) {
+                if (const auto allocations = count(fn); allocations != 0) {
+                    fmt::print(stderr, "frame {} of {} made {} heap allocations\n", frame, frames, allocations);
+                    std::abort();
+                }
+            }
+        }
+    }
+};
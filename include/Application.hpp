@@ -1,11 +1,15 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <memory>
 #include <concepts>
 
 #include <Event.hpp>
 #include <Window.hpp>
+#include <FramePacer.hpp>
+#include <FrameArena.hpp>
+#include <AllocationTracker.hpp>
 #include <RenderContext.hpp>
 
 template <typename T>
@@ -27,42 +31,114 @@ template <typename T>
 struct Application {
     std::unique_ptr<Window> window;
     std::unique_ptr<RenderContext> renderContext;
+    std::unique_ptr<FramePacer> pacer;
+    std::unique_ptr<FrameArena> frameArena;
 
     Application(const char* title, int width, int height) {
         window = std::make_unique<Window>(title, width, height);
         renderContext = std::make_unique<RenderContext>();
+        pacer = std::make_unique<FramePacer>(*window);
+        frameArena = std::make_unique<FrameArena>();
     }
 
-    void handleEvents() {
+    // On-demand rendering: instead of redrawing continuously the loop sleeps in Window::waitEvents and
+    // only runs update/renderFrame for a few frames after an event or a requestRedraw(). Anything that
+    // animates has to keep calling requestRedraw() for as long as it does.
+    void setOnDemandRendering(bool enabled) {
+        _onDemand.store(enabled, std::memory_order_relaxed);
+        requestRedraw();
+    }
+
+    bool onDemandRendering() const {
+        return _onDemand.load(std::memory_order_relaxed);
+    }
+
+    // Schedules at least `frames` more frames. Safe to call from any thread.
+    void requestRedraw(int frames = REDRAW_FRAMES) {
+        auto current = _redrawFrames.load(std::memory_order_relaxed);
+        while (current < frames && !_redrawFrames.compare_exchange_weak(current, frames, std::memory_order_relaxed)) {}
+        if (_onDemand.load(std::memory_order_relaxed)) {
+            window->wakeUp();
+        }
+    }
+
+    bool handleEvents() {
         window->pumpEvents();
 
+        bool received = false;
         while (auto event = window->pollEvent()) {
+            received = true;
             if constexpr (HasHandleEvent<T>) {
                 static_cast<T&>(*this).handleEvent(*event);
             }
         }
+        return received;
     }
 
     void run() {
-        using Clock = std::chrono::high_resolution_clock;
-
-        auto last_time = Clock::now();
+        _lastTime = Clock::now();
         while (!window->shouldClose()) {
-            const auto current_time = Clock::now();
-            const auto delta_time = current_time - std::exchange(last_time, current_time);
-            const auto dt = std::chrono::duration<double>(delta_time).count();
+            runFrame();
+        }
+    }
 
-            handleEvents();
+    // One iteration of the main loop; exposed so that tools and checks can drive frames themselves.
+    void runFrame() {
+        if (_onDemand.load(std::memory_order_relaxed) && _redrawFrames.load(std::memory_order_relaxed) == 0) {
+            /// time spent idle is not simulation time
+            const auto wait_start = Clock::now();
+            window->waitEvents(IDLE_TIMEOUT);
+            _lastTime += Clock::now() - wait_start;
+        }
 
-            if constexpr (HasUpdate<T>) {
-                static_cast<T&>(*this).update(dt);
-            }
+        const auto current_time = Clock::now();
+        const auto delta_time = current_time - std::exchange(_lastTime, current_time);
+        const auto dt = std::chrono::duration<double>(delta_time).count();
+        const auto allocations = AllocationTracker::thread();
 
-            if constexpr (HasRenderFrame<T>) {
-                static_cast<T &>(*this).renderFrame(dt);
-            }
+        if (pacer->lowLatency()) {
+            renderContext->frameSync.waitPrevious();
+        }
 
-            window->swapBuffers();
+        if (handleEvents()) {
+            requestRedraw();
         }
+
+        if (_onDemand.load(std::memory_order_relaxed) && _redrawFrames.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+
+        if constexpr (HasUpdate<T>) {
+            static_cast<T&>(*this).update(dt);
+        }
+
+        renderContext->frameSync.begin();
+        if constexpr (HasRenderFrame<T>) {
+            static_cast<T &>(*this).renderFrame(dt);
+        }
+        renderContext->frameSync.end();
+        frameArena->reset();
+        renderContext->memory.enforceBudget();
+
+        window->swapBuffers();
+        pacer->endFrame();
+
+        auto current = _redrawFrames.load(std::memory_order_relaxed);
+        while (current > 0 && !_redrawFrames.compare_exchange_weak(current, current - 1, std::memory_order_relaxed)) {}
+
+        frameAllocations = AllocationTracker::thread() - allocations;
     }
+
+    // Heap activity of the main thread during the previous frame; zero unless built with TRACK_ALLOCATIONS.
+    AllocationCounters frameAllocations{};
+
+private:
+    using Clock = std::chrono::high_resolution_clock;
+
+    static constexpr int REDRAW_FRAMES = 2; /// ImGui needs a frame after input to settle its layout
+    static constexpr double IDLE_TIMEOUT = 0.5;
+
+    std::atomic<bool> _onDemand{false}; /// read by requestRedraw() from any thread
+    std::atomic<int> _redrawFrames{REDRAW_FRAMES};
+    Clock::time_point _lastTime = Clock::now();
 };
\ No newline at end of file
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <GL/gl3w.h>
+#include <GLFW/glfw3.h>
+#include <GpuMemory.hpp>
+#include <Image.hpp>
+#include <utils/queue.hpp>
+
+#include <fmt/format.h>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <variant>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <span>
+#include <bit>
+
+// Buffer created with glNamedBufferStorage and filled by `fill` through a write mapping of the whole
+// buffer, on the loader thread; `fill` has to own, or keep alive, whatever it copies from.
+struct BufferUpload {
+    GLsizeiptr size = 0;
+    GLbitfield flags = 0; /// storage flags besides GL_MAP_WRITE_BIT, which every upload gets
+    GpuMemoryCategory category = GpuMemoryCategory::Mesh;
+    std::function<void(std::span<std::byte>)> fill{};
+};
+
+// Immutable RGBA8 texture; levels past the first are generated on the loader thread.
+struct TextureUpload {
+    ImageData image;
+    GLsizei levels = 1;
+};
+
+// `handle` is GL_NONE when the upload failed.
+struct UploadResult {
+    uint64_t id = 0;
+    GpuResource resource = GpuResource::Buffer;
+    GLuint handle = GL_NONE;
+    GpuMemoryCategory category = GpuMemoryCategory::Mesh;
+    size_t bytes = 0;
+};
+
+// Creates and fills buffers and textures on a loader thread that owns a hidden context sharing objects
+// with the main one, so the driver's copies of large uploads happen outside frame time. Jobs travel
+// to the loader and finished handles back through lock-free queues. The loader fences every batch and
+// waits for it before publishing, so a handle returned by poll() is complete and can be used right
+// away. Handles belong to the caller from then on; release() deletes one and its tracking.
+struct AsyncUploader {
+    static constexpr size_t QUEUE_CAPACITY = 1024;
+    static constexpr size_t BATCH = 16; /// jobs per fence
+
+    AsyncUploader(GpuMemoryRegistry& memory, GLFWwindow* context) : _memory(memory) {
+        _loader = std::thread([this, context] { loaderLoop(context); });
+    }
+
+    ~AsyncUploader() {
+        _stop.store(true, std::memory_order_release);
+        wake();
+        _loader.join();
+
+        /// finished but never polled
+        while (auto result = _results.pop()) {
+            destroy(*result);
+        }
+    }
+
+    AsyncUploader(const AsyncUploader&) = delete;
+    AsyncUploader& operator=(const AsyncUploader&) = delete;
+
+    uint64_t submit(BufferUpload upload) {
+        return enqueue(std::move(upload));
+    }
+
+    uint64_t submit(TextureUpload upload) {
+        return enqueue(std::move(upload));
+    }
+
+    // Main thread: hands every finished upload to `fn`, after adding it to the memory registry.
+    template <typename Fn>
+    size_t poll(Fn&& fn) {
+        while (!_backlog.empty() && _jobs.push(std::move(_backlog.front()))) {
+            _backlog.pop_front();
+            wake();
+        }
+
+        size_t count = 0;
+        while (auto result = _results.pop()) {
+            if (result->handle != GL_NONE) {
+                _memory.track(result->resource, result->handle, result->category, result->bytes);
+            }
+            fn(*result);
+            count += 1;
+        }
+        _completed += count;
+        return count;
+    }
+
+    void release(const UploadResult& result) {
+        _memory.release(result.resource, result.handle);
+        destroy(result);
+    }
+
+    // Submitted and not yet returned by poll().
+    size_t pending() const {
+        return static_cast<size_t>(_submitted - _completed);
+    }
+
+private:
+    struct Job {
+        uint64_t id = 0;
+        std::variant<BufferUpload, TextureUpload> work{};
+    };
+
+    template <typename Work>
+    uint64_t enqueue(Work&& work) {
+        const auto id = ++_submitted;
+        Job job{id, std::forward<Work>(work)};
+        /// keeps submission order: nothing overtakes the backlog
+        if (!_backlog.empty() || !_jobs.push(std::move(job))) {
+            _backlog.push_back(std::move(job));
+            return id;
+        }
+        wake();
+        return id;
+    }
+
+    void wake() {
+        _signal.fetch_add(1, std::memory_order_release);
+        _signal.notify_one();
+    }
+
+    static void destroy(const UploadResult& result) {
+        if (result.resource == GpuResource::Texture) {
+            glDeleteTextures(1, &result.handle);
+        } else {
+            glDeleteBuffers(1, &result.handle);
+        }
+    }
+
+    void loaderLoop(GLFWwindow* context) {
+        glfwMakeContextCurrent(context);
+
+        std::vector<UploadResult> batch{};
+        while (true) {
+            if (auto job = _jobs.pop()) {
+                batch.push_back(std::visit([](auto& work) { return run(work); }, job->work));
+                batch.back().id = job->id;
+                if (batch.size() == BATCH) {
+                    publish(batch);
+                }
+                continue;
+            }
+            if (!batch.empty()) {
+                publish(batch);
+                continue;
+            }
+
+            /// read before checking the queue, so a push in between changes it and wait() returns
+            const auto seen = _signal.load(std::memory_order_acquire);
+            if (!_jobs.empty()) {
+                continue;
+            }
+            if (_stop.load(std::memory_order_acquire)) {
+                break;
+            }
+            _signal.wait(seen, std::memory_order_acquire);
+        }
+
+        glfwMakeContextCurrent(nullptr);
+    }
+
+    void publish(std::vector<UploadResult>& batch) {
+        const auto fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (true) {
+            const auto status = glClientWaitSync(fence, flags, 100'000'000);
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED) {
+                break;
+            }
+            flags = 0;
+        }
+        glDeleteSync(fence);
+
+        for (auto& result : batch) {
+            while (!_results.push(std::move(result))) {
+                /// the main thread drains it every frame, unless it is waiting for us to stop
+                if (_stop.load(std::memory_order_acquire)) {
+                    destroy(result);
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        batch.clear();
+    }
+
+    static UploadResult run(BufferUpload& upload) {
+        UploadResult result{};
+        result.resource = GpuResource::Buffer;
+        result.category = upload.category;
+        result.bytes = static_cast<size_t>(upload.size);
+
+        glCreateBuffers(1, &result.handle);
+        glNamedBufferStorage(result.handle, std::max<GLsizeiptr>(upload.size, 1), nullptr, upload.flags | GL_MAP_WRITE_BIT);
+        if (upload.size > 0 && upload.fill) {
+            auto data = static_cast<std::byte*>(glMapNamedBufferRange(result.handle, 0, upload.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+            if (data == nullptr) {
+                fmt::print("Failed to map a {} byte upload buffer\n", upload.size);
+                glDeleteBuffers(1, &result.handle);
+                result.handle = GL_NONE;
+                result.bytes = 0;
+                return result;
+            }
+            upload.fill(std::span<std::byte>(data, static_cast<size_t>(upload.size)));
+            glUnmapNamedBuffer(result.handle);
+        }
+        return result;
+    }
+
+    static UploadResult run(TextureUpload& upload) {
+        const auto [width, height] = upload.image.info();
+        const auto levels = std::clamp<GLsizei>(upload.levels, 1, static_cast<GLsizei>(std::bit_width(std::max(width, height))));
+
+        UploadResult result{};
+        result.resource = GpuResource::Texture;
+        result.category = GpuMemoryCategory::Texture;
+        result.bytes = GpuMemoryRegistry::textureBytes(GL_RGBA8, static_cast<GLsizei>(width), static_cast<GLsizei>(height), levels);
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &result.handle);
+        glTextureStorage2D(result.handle, levels, GL_RGBA8, static_cast<GLsizei>(width), static_cast<GLsizei>(height));
+        glTextureParameteri(result.handle, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTextureParameteri(result.handle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTextureSubImage2D(result.handle, 0, 0, 0, static_cast<GLsizei>(width), static_cast<GLsizei>(height), GL_RGBA, GL_UNSIGNED_BYTE, upload.image.pixels().data());
+        if (levels > 1) {
+            glGenerateTextureMipmap(result.handle);
+        }
+        return result;
+    }
+
+    GpuMemoryRegistry& _memory;
+
+    SpscQueue<Job> _jobs{QUEUE_CAPACITY};
+    SpscQueue<UploadResult> _results{QUEUE_CAPACITY};
+    std::deque<Job> _backlog{}; /// main thread only, for jobs that did not fit into _jobs
+    std::atomic<uint32_t> _signal{0};
+    std::atomic<bool> _stop{false};
+    uint64_t _submitted = 0;
+    uint64_t _completed = 0;
+
+    std::thread _loader{};
+};
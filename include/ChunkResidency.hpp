@@ -0,0 +1,249 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <algorithm>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <list>
+
+// Column of an unbounded grid of chunks on the xz plane.
+struct ChunkCoord {
+    int32_t x = 0;
+    int32_t z = 0;
+
+    friend bool operator==(const ChunkCoord&, const ChunkCoord&) = default;
+};
+
+struct ChunkCoordHash {
+    size_t operator()(const ChunkCoord& coord) const {
+        const auto key = static_cast<uint64_t>(static_cast<uint32_t>(coord.x)) << 32 | static_cast<uint32_t>(coord.z);
+        return std::hash<uint64_t>{}(key);
+    }
+};
+
+// Decides which chunks around the eye are kept, in what order work on them happens, and which GPU
+// meshes to drop when they exceed a byte budget. The budget counts the bytes of the meshes
+// themselves, that is their ranges in the caller's MeshHeap, not the heap's buffers; those only
+// shrink when the caller trims the heap, and are bounded by the GpuMemoryRegistry budget, whose
+// eviction callback uses victim() as well.
+//
+// It only tracks coordinates: the caller generates and meshes what takeLoads() hands out, unloads
+// what update() reports, and reports meshes with meshed() and unmeshed(). Chunks in view of the eye
+// count as used every frame; victim() returns the one that has been out of view longest, once that
+// is at least `min_idle` frames, so nothing on screen is evicted. Evicted chunks are not remeshed
+// until they come back into view.
+struct ChunkResidency {
+    int radius = 6;              /// chunks within this many chunk widths of the eye are loaded
+    int unload_margin = 2;       /// and unloaded only beyond radius + unload_margin
+    float cone = 0.5f;           /// cosine of the half-angle around the view direction that counts as in view
+    float behind_penalty = 4.0f; /// distance multiplier for chunks outside the cone when ordering work
+    size_t mesh_budget = size_t(32) << 20; /// vertex and index bytes of meshed chunks, 0 for none
+    uint64_t min_idle = 30; /// frames
+
+    ChunkResidency(const glm::vec2& origin, float size) : _origin(origin), _size(size) {}
+
+    // Call once per frame before anything else. Queues chunks that came into range and appends the
+    // loaded ones that fell out of it to `unload`; the caller drops them and calls nothing else for them.
+    void update(const glm::vec3& eye, const glm::vec3& direction, std::vector<ChunkCoord>& unload) {
+        _frame += 1;
+        _eye = glm::vec2(eye.x, eye.z);
+        const auto flat = glm::vec2(direction.x, direction.z);
+        const auto length = glm::length(flat);
+        _direction = length > 1e-4f ? flat / length : glm::vec2(0.0f);
+
+        const auto cell = glm::floor((_eye - _origin) / _size);
+        const auto center = ChunkCoord{static_cast<int32_t>(cell.x), static_cast<int32_t>(cell.y)};
+        if (_centered && center == _center) {
+            return;
+        }
+        _centered = true;
+        _center = center;
+
+        const auto keep = static_cast<int64_t>(radius + unload_margin) * (radius + unload_margin);
+        for (auto it = _chunks.begin(); it != _chunks.end();) {
+            if (distance2(it->first) <= keep) {
+                ++it;
+                continue;
+            }
+            if (it->second.loaded) {
+                unload.push_back(it->first);
+                if (it->second.bytes != 0) {
+                    dropMesh(it->second);
+                }
+                _loaded -= 1;
+            }
+            it = _chunks.erase(it);
+        }
+        _queue.erase(std::remove_if(_queue.begin(), _queue.end(), [this](const ChunkCoord& coord) {
+            return !_chunks.contains(coord);
+        }), _queue.end());
+
+        for (int32_t dz = -radius; dz <= radius; ++dz) {
+            for (int32_t dx = -radius; dx <= radius; ++dx) {
+                const auto coord = ChunkCoord{center.x + dx, center.z + dz};
+                if (dx * dx + dz * dz <= radius * radius && _chunks.try_emplace(coord).second) {
+                    _queue.push_back(coord);
+                }
+            }
+        }
+    }
+
+    // Moves up to `count` queued chunks, highest priority first, to `out` and counts them as loaded.
+    void takeLoads(size_t count, std::vector<ChunkCoord>& out) {
+        count = std::min(count, _queue.size());
+        std::partial_sort(_queue.begin(), _queue.begin() + static_cast<std::ptrdiff_t>(count), _queue.end(), [this](const ChunkCoord& a, const ChunkCoord& b) {
+            return priority(a) < priority(b);
+        });
+        for (size_t i = 0; i < count; ++i) {
+            _chunks[_queue[i]].loaded = true;
+            out.push_back(_queue[i]);
+        }
+        _queue.erase(_queue.begin(), _queue.begin() + static_cast<std::ptrdiff_t>(count));
+        _loaded += count;
+    }
+
+    // Distance from the eye to the chunk's centre, stretched for chunks outside the view cone; lower goes first.
+    float priority(const ChunkCoord& coord) const {
+        const auto offset = center(coord) - _eye;
+        const auto distance = glm::length(offset);
+        return facing(offset, distance) ? distance : distance * behind_penalty;
+    }
+
+    // Chunks the eye stands on or next to are always in view, whichever way it faces.
+    bool inView(const ChunkCoord& coord) const {
+        const auto offset = center(coord) - _eye;
+        return facing(offset, glm::length(offset));
+    }
+
+    // Marks in-view meshes as used this frame; the caller may skip others.
+    void touch(const ChunkCoord& coord) {
+        auto& chunk = _chunks.at(coord);
+        if (chunk.bytes != 0 && inView(coord)) {
+            chunk.last_used = _frame;
+            _lru.splice(_lru.begin(), _lru, chunk.lru);
+        }
+    }
+
+    void meshed(const ChunkCoord& coord, size_t bytes) {
+        auto& chunk = _chunks.at(coord);
+        if (chunk.bytes != 0) {
+            dropMesh(chunk);
+        }
+        chunk.bytes = std::max<size_t>(bytes, 1);
+        chunk.last_used = _frame;
+        chunk.evicted = false;
+        _lru.push_front(coord);
+        chunk.lru = _lru.begin();
+        _mesh_bytes += chunk.bytes;
+        _meshed += 1;
+    }
+
+    // `evicted` keeps the chunk from being remeshed until it is back in view.
+    void unmeshed(const ChunkCoord& coord, bool evicted) {
+        auto& chunk = _chunks.at(coord);
+        if (chunk.bytes != 0) {
+            dropMesh(chunk);
+        }
+        chunk.evicted = evicted;
+    }
+
+    bool parked(const ChunkCoord& coord) const {
+        return _chunks.at(coord).evicted && !inView(coord);
+    }
+
+    // Bytes of meshes on their way to the GPU, charged against the budget until they arrive or are
+    // dropped; meshed() does not release them.
+    void reserve(size_t bytes) {
+        _reserved_bytes += bytes;
+    }
+
+    void unreserve(size_t bytes) {
+        _reserved_bytes -= bytes;
+    }
+
+    bool fits(size_t bytes) const {
+        return mesh_budget == 0 || _mesh_bytes + _reserved_bytes + bytes <= mesh_budget;
+    }
+
+    std::optional<ChunkCoord> victim() const {
+        if (_lru.empty() || _frame - _chunks.at(_lru.back()).last_used < min_idle) {
+            return std::nullopt;
+        }
+        return _lru.back();
+    }
+
+    size_t meshBytes() const {
+        return _mesh_bytes;
+    }
+
+    size_t reservedBytes() const {
+        return _reserved_bytes;
+    }
+
+    size_t loaded() const {
+        return _loaded;
+    }
+
+    size_t meshed() const {
+        return _meshed;
+    }
+
+    size_t queued() const {
+        return _queue.size();
+    }
+
+    glm::vec2 origin(const ChunkCoord& coord) const {
+        return _origin + glm::vec2(static_cast<float>(coord.x), static_cast<float>(coord.z)) * _size;
+    }
+
+private:
+    struct Chunk {
+        bool loaded = false;
+        bool evicted = false;
+        size_t bytes = 0; /// of its mesh, 0 when it has none
+        uint64_t last_used = 0;
+        std::list<ChunkCoord>::iterator lru{};
+    };
+
+    glm::vec2 center(const ChunkCoord& coord) const {
+        return origin(coord) + glm::vec2(_size * 0.5f);
+    }
+
+    bool facing(const glm::vec2& offset, float distance) const {
+        return distance < _size * 1.5f || glm::dot(offset, _direction) >= cone * distance;
+    }
+
+    int64_t distance2(const ChunkCoord& coord) const {
+        const auto dx = static_cast<int64_t>(coord.x) - _center.x;
+        const auto dz = static_cast<int64_t>(coord.z) - _center.z;
+        return dx * dx + dz * dz;
+    }
+
+    void dropMesh(Chunk& chunk) {
+        _lru.erase(chunk.lru);
+        _mesh_bytes -= chunk.bytes;
+        _meshed -= 1;
+        chunk.bytes = 0;
+    }
+
+    glm::vec2 _origin;
+    float _size;
+
+    std::unordered_map<ChunkCoord, Chunk, ChunkCoordHash> _chunks{};
+    std::vector<ChunkCoord> _queue{};
+    std::list<ChunkCoord> _lru{}; /// meshed chunks, most recently used first
+    size_t _mesh_bytes = 0;
+    size_t _reserved_bytes = 0;
+    size_t _loaded = 0;
+    size_t _meshed = 0;
+
+    uint64_t _frame = 0;
+    glm::vec2 _eye{};
+    glm::vec2 _direction{};
+    ChunkCoord _center{};
+    bool _centered = false;
+};
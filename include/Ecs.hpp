@@ -0,0 +1,291 @@
+#pragma once
+
+#include <utils/parallel.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <limits>
+#include <span>
+#include <bit>
+
+struct Entity {
+    uint32_t index = std::numeric_limits<uint32_t>::max();
+    uint32_t generation = 0;
+
+    bool operator==(const Entity&) const = default;
+};
+
+namespace detail {
+    inline uint32_t nextComponentId() {
+        static uint32_t counter = 0;
+        return counter++;
+    }
+
+    // Dense per-type id, assigned on first use; bit position in a system's access mask.
+    template <typename T>
+    uint32_t componentId() {
+        static const uint32_t id = nextComponentId();
+        return id;
+    }
+
+    struct StorageBase {
+        virtual ~StorageBase() = default;
+        virtual void remove(uint32_t entity) = 0;
+    };
+}
+
+// Sparse set: components of one type packed contiguously in `components`, with `entities` holding the
+// owner of each slot and `sparse` mapping an entity index to its slot. Removal swaps with the last slot.
+template <typename T>
+struct SparseSet : detail::StorageBase {
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    template <typename... Args>
+    T& emplace(uint32_t entity, Args&&... args) {
+        if (_sparse.size() <= entity) {
+            _sparse.resize(entity + 1, NONE);
+        }
+        if (_sparse[entity] != NONE) {
+            return _components[_sparse[entity]] = T{std::forward<Args>(args)...};
+        }
+        _sparse[entity] = static_cast<uint32_t>(_entities.size());
+        _entities.push_back(entity);
+        return _components.emplace_back(T{std::forward<Args>(args)...});
+    }
+
+    void remove(uint32_t entity) override {
+        if (!contains(entity)) {
+            return;
+        }
+        const auto slot = _sparse[entity];
+        const auto last = _entities.back();
+
+        _components[slot] = std::move(_components.back());
+        _entities[slot] = last;
+        _sparse[last] = slot;
+
+        _components.pop_back();
+        _entities.pop_back();
+        _sparse[entity] = NONE;
+    }
+
+    bool contains(uint32_t entity) const {
+        return entity < _sparse.size() && _sparse[entity] != NONE;
+    }
+
+    T& get(uint32_t entity) {
+        return _components[_sparse[entity]];
+    }
+
+    const T& get(uint32_t entity) const {
+        return _components[_sparse[entity]];
+    }
+
+    size_t size() const {
+        return _entities.size();
+    }
+
+    std::span<T> components() {
+        return _components;
+    }
+
+    std::span<const uint32_t> entities() const {
+        return _entities;
+    }
+
+private:
+    std::vector<uint32_t> _sparse{};
+    std::vector<uint32_t> _entities{};
+    std::vector<T> _components{};
+};
+
+// Entities are generation-checked indices; components live in one SparseSet per type. Creating and
+// destroying entities or adding component types is not thread-safe; reading and writing components of
+// different types from different threads is, which is what the Scheduler relies on.
+struct Registry {
+    static constexpr size_t CHUNK = 1024; /// entities per task in parallelEach
+
+    Entity create() {
+        if (!_free.empty()) {
+            const auto index = _free.back();
+            _free.pop_back();
+            return Entity{index, _generations[index]};
+        }
+        _generations.push_back(0);
+        return Entity{static_cast<uint32_t>(_generations.size() - 1), 0};
+    }
+
+    void destroy(Entity entity) {
+        if (!alive(entity)) {
+            return;
+        }
+        for (auto& storage : _storages) {
+            if (storage) {
+                storage->remove(entity.index);
+            }
+        }
+        _generations[entity.index] += 1;
+        _free.push_back(entity.index);
+    }
+
+    bool alive(Entity entity) const {
+        return entity.index < _generations.size() && _generations[entity.index] == entity.generation;
+    }
+
+    template <typename T, typename... Args>
+    T& emplace(Entity entity, Args&&... args) {
+        return storage<T>().emplace(entity.index, std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    void remove(Entity entity) {
+        storage<T>().remove(entity.index);
+    }
+
+    template <typename T>
+    bool has(Entity entity) const {
+        const auto id = detail::componentId<T>();
+        return id < _storages.size() && _storages[id] && static_cast<const SparseSet<T>&>(*_storages[id]).contains(entity.index);
+    }
+
+    template <typename T>
+    T& get(Entity entity) {
+        return storage<T>().get(entity.index);
+    }
+
+    template <typename T>
+    SparseSet<T>& storage() {
+        const auto id = detail::componentId<T>();
+        if (_storages.size() <= id) {
+            _storages.resize(id + 1);
+        }
+        if (!_storages[id]) {
+            _storages[id] = std::make_unique<SparseSet<T>>();
+        }
+        return static_cast<SparseSet<T>&>(*_storages[id]);
+    }
+
+    // Calls fn(entity, components&...) for every entity that has all of Ts, walking the smallest set.
+    template <typename... Ts, typename Fn>
+    void each(Fn&& fn) {
+        auto sets = std::tuple<SparseSet<Ts>&...>(storage<Ts>()...);
+        const auto& driver = smallest(std::get<SparseSet<Ts>&>(sets)...);
+        eachRange<Ts...>(sets, driver, 0, driver.size(), fn);
+    }
+
+    // Same as each(), split into chunks on the shared thread pool; fn must only touch its own entity.
+    template <typename... Ts, typename Fn>
+    void parallelEach(Fn&& fn) {
+        auto sets = std::tuple<SparseSet<Ts>&...>(storage<Ts>()...);
+        const auto& driver = smallest(std::get<SparseSet<Ts>&>(sets)...);
+        const auto count = driver.size();
+        parallelFor((count + CHUNK - 1) / CHUNK, [&](size_t chunk) {
+            eachRange<Ts...>(sets, driver, chunk * CHUNK, std::min(count, (chunk + 1) * CHUNK), fn);
+        });
+    }
+
+private:
+    struct Sized {
+        std::span<const uint32_t> entities;
+
+        size_t size() const {
+            return entities.size();
+        }
+    };
+
+    template <typename... Sets>
+    static Sized smallest(const Sets&... sets) {
+        Sized result{};
+        auto first = true;
+        ((first || sets.size() < result.size() ? (result = Sized{sets.entities()}, first = false) : false), ...);
+        return result;
+    }
+
+    template <typename... Ts, typename Sets, typename Fn>
+    void eachRange(Sets& sets, const Sized& driver, size_t begin, size_t end, Fn& fn) {
+        for (size_t i = begin; i < end; ++i) {
+            const auto index = driver.entities[i];
+            if ((std::get<SparseSet<Ts>&>(sets).contains(index) && ...)) {
+                fn(Entity{index, _generations[index]}, std::get<SparseSet<Ts>&>(sets).get(index)...);
+            }
+        }
+    }
+
+    std::vector<uint32_t> _generations{};
+    std::vector<uint32_t> _free{};
+    std::vector<std::unique_ptr<detail::StorageBase>> _storages{};
+};
+
+template <typename... Ts>
+struct Reads {};
+
+template <typename... Ts>
+struct Writes {};
+
+// Runs systems once per run(). Each system declares the component types it reads and writes; systems
+// are placed, in the order they were added, into the earliest stage after every earlier system they
+// conflict with (one writes what the other reads or writes). Systems of one stage run in parallel.
+// Access masks are 64 bits wide, so systems can only name the first 64 component types to get an id.
+struct Scheduler {
+    using System = std::function<void(Registry&, float)>;
+
+    explicit Scheduler(Registry& registry) : _registry(registry) {}
+
+    template <typename... R, typename... W, typename Fn>
+    void add(Reads<R...>, Writes<W...>, Fn&& fn) {
+        /// storages are created up front, never concurrently from inside a stage
+        (_registry.storage<R>(), ...);
+        (_registry.storage<W>(), ...);
+
+        Entry entry{System(std::forward<Fn>(fn)), (mask<R>() | ... | 0), (mask<W>() | ... | 0), 0};
+        for (const auto& other : _systems) {
+            if (conflicts(entry, other)) {
+                entry.stage = std::max(entry.stage, other.stage + 1);
+            }
+        }
+        if (entry.stage == _stages.size()) {
+            _stages.emplace_back();
+        }
+        _stages[entry.stage].push_back(_systems.size());
+        _systems.push_back(std::move(entry));
+    }
+
+    void run(float dt) {
+        for (const auto& stage : _stages) {
+            parallelFor(stage.size(), [&](size_t i) {
+                _systems[stage[i]].fn(_registry, dt);
+            });
+        }
+    }
+
+    size_t stages() const {
+        return _stages.size();
+    }
+
+private:
+    struct Entry {
+        System fn;
+        uint64_t reads;
+        uint64_t writes;
+        size_t stage;
+    };
+
+    template <typename T>
+    static uint64_t mask() {
+        const auto id = detail::componentId<T>();
+        assert(id < 64 && "Scheduler access masks cover the first 64 component types");
+        return uint64_t{1} << id;
+    }
+
+    static bool conflicts(const Entry& a, const Entry& b) {
+        return (a.writes & (b.reads | b.writes)) != 0 || (b.writes & a.reads) != 0;
+    }
+
+    Registry& _registry;
+    std::vector<Entry> _systems{};
+    std::vector<std::vector<size_t>> _stages{}; /// indices into _systems, built by add()
+};
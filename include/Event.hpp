@@ -14,6 +14,8 @@ struct FramebufferResizeEvent {
 
 struct WindowCloseEvent {};
 
+struct WindowRefreshEvent {};
+
 struct KeyEvent {
     int key;
     int scancode;
@@ -42,6 +44,7 @@ using Event = std::variant<
     WindowResizeEvent,
     FramebufferResizeEvent,
     WindowCloseEvent,
+    WindowRefreshEvent,
     KeyEvent,
     MouseMoveEvent,
     MouseButtonEvent,
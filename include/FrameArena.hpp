@@ -0,0 +1,137 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <memory_resource>
+#include <string_view>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <bit>
+
+// Linear allocator for data that lives at most until the end of the frame. Allocation is a pointer bump,
+// deallocation is a no-op and reset() rewinds everything at once. When a frame overflows the block the
+// extra memory comes from `upstream`, and the next reset() grows the block to the high-water mark, so a
+// steady-state frame never reaches the heap. Not thread-safe; owned and used by the render thread.
+struct FrameArena : std::pmr::memory_resource {
+    explicit FrameArena(size_t capacity = 1 << 20, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : _upstream(upstream) {
+        grow(capacity);
+    }
+
+    ~FrameArena() override {
+        release();
+        _upstream->deallocate(_block, _capacity, alignof(std::max_align_t));
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Rewinds a nested region on destruction; for subsystems that need temporary memory within the frame.
+    struct Scope {
+        explicit Scope(FrameArena& arena) : _arena(arena), _offset(arena._offset), _overflows(arena._overflow.size()) {}
+
+        ~Scope() {
+            /// memory handed out from overflow blocks stays until reset()
+            if (_arena._overflow.size() == _overflows) {
+                _arena._offset = _offset;
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        FrameArena& _arena;
+        size_t _offset;
+        size_t _overflows;
+    };
+
+    Scope scope() {
+        return Scope{*this};
+    }
+
+    void reset() {
+        const auto required = _offset + _overflow_bytes;
+        _high_water = std::max(_high_water, required);
+
+        release();
+        if (_high_water > _capacity) {
+            _upstream->deallocate(_block, _capacity, alignof(std::max_align_t));
+            grow(std::bit_ceil(_high_water));
+        }
+        _offset = 0;
+    }
+
+    // Formats into arena memory; the result is null-terminated and valid until reset(). The text is sized
+    // first and then written straight into a single allocation.
+    template <typename... Args>
+    std::string_view format(std::string_view format, const Args&... args) {
+        const auto size = fmt::formatted_size(fmt::runtime(format), args...);
+        auto data = static_cast<char*>(allocate(size + 1, 1));
+        fmt::format_to_n(data, size, fmt::runtime(format), args...);
+        data[size] = '\0';
+        return {data, size};
+    }
+
+    size_t used() const {
+        return _offset + _overflow_bytes;
+    }
+
+    size_t capacity() const {
+        return _capacity;
+    }
+
+    size_t highWater() const {
+        return std::max(_high_water, used());
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        const auto base = reinterpret_cast<uintptr_t>(_block);
+        const auto aligned = (base + _offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        if (aligned + bytes <= base + _capacity) {
+            _offset = aligned + bytes - base;
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        auto& overflow = _overflow.emplace_back(Overflow{_upstream->allocate(bytes, alignment), bytes, alignment});
+        _overflow_bytes += bytes;
+        return overflow.pointer;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+private:
+    struct Overflow {
+        void* pointer;
+        size_t size;
+        size_t alignment;
+    };
+
+    void grow(size_t capacity) {
+        _block = static_cast<std::byte*>(_upstream->allocate(capacity, alignof(std::max_align_t)));
+        _capacity = capacity;
+    }
+
+    void release() {
+        for (const auto& overflow : _overflow) {
+            _upstream->deallocate(overflow.pointer, overflow.size, overflow.alignment);
+        }
+        _overflow.clear();
+        _overflow_bytes = 0;
+    }
+
+    std::pmr::memory_resource* _upstream;
+    std::byte* _block = nullptr;
+    size_t _capacity = 0;
+    size_t _offset = 0;
+    size_t _high_water = 0;
+    size_t _overflow_bytes = 0;
+    std::vector<Overflow> _overflow{};
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <Window.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <thread>
+#include <cmath>
+
+enum class PacingMode {
+    VSync,    /// swap interval 1
+    Adaptive, /// swap interval -1 (late frames tear instead of waiting a whole refresh), vsync when unsupported
+    Uncapped, /// swap interval 0, no limiter
+    Limited   /// swap interval 0, CPU limiter at targetFps()
+};
+
+struct FrameStats {
+    double mean;     /// ms
+    double variance; /// ms^2
+    double stddev;   /// ms
+    double min;      /// ms
+    double max;      /// ms
+};
+
+// Decides when the next frame may start. In Limited mode endFrame() sleeps for the bulk of the remaining
+// time and spins for the rest; the spin threshold follows the observed oversleep of the OS scheduler,
+// which keeps the deadline error well below a millisecond without burning a core for the whole frame.
+// Every mode records the achieved frame times, see stats().
+struct FramePacer {
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t HISTORY = 240;
+
+    explicit FramePacer(Window& window) : _window(window) {
+        setMode(PacingMode::VSync);
+    }
+
+    void setMode(PacingMode mode, double target_fps = 0.0) {
+        if (mode == PacingMode::Limited && target_fps <= 0.0) {
+            mode = PacingMode::Uncapped;
+        }
+
+        _mode = mode;
+        _target_fps = target_fps;
+        _period = mode == PacingMode::Limited
+            ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / target_fps))
+            : Clock::duration::zero();
+        _deadline = Clock::now() + _period;
+
+        switch (mode) {
+            case PacingMode::VSync:
+                _window.setSwapInterval(1);
+                break;
+            case PacingMode::Adaptive:
+                _window.setSwapInterval(_window.supportsAdaptiveSync() ? -1 : 1);
+                break;
+            case PacingMode::Uncapped:
+            case PacingMode::Limited:
+                _window.setSwapInterval(0);
+                break;
+        }
+    }
+
+    PacingMode mode() const {
+        return _mode;
+    }
+
+    double targetFps() const {
+        return _target_fps;
+    }
+
+    // When enabled the application waits for the previous frame to finish on the GPU before sampling
+    // input, so the input it reads is presented as soon as possible instead of queueing behind it.
+    void setLowLatency(bool enabled) {
+        _low_latency = enabled;
+    }
+
+    bool lowLatency() const {
+        return _low_latency;
+    }
+
+    // Call right after the buffers are swapped.
+    void endFrame() {
+        if (_mode == PacingMode::Limited) {
+            waitUntil(_deadline);
+
+            /// a missed deadline restarts the schedule instead of trying to catch up with short frames
+            _deadline += _period;
+            if (const auto now = Clock::now(); _deadline < now) {
+                _deadline = now + _period;
+            }
+        }
+
+        const auto now = Clock::now();
+        if (_last != Clock::time_point{}) {
+            _history[_cursor] = std::chrono::duration<double, std::milli>(now - _last).count();
+            _cursor = (_cursor + 1) % HISTORY;
+            _count = std::min(_count + 1, HISTORY);
+        }
+        _last = now;
+    }
+
+    FrameStats stats() const {
+        if (_count == 0) {
+            return {};
+        }
+
+        double sum = 0.0;
+        double min = _history[0];
+        double max = _history[0];
+        for (size_t i = 0; i < _count; ++i) {
+            sum += _history[i];
+            min = std::min(min, _history[i]);
+            max = std::max(max, _history[i]);
+        }
+
+        const auto mean = sum / static_cast<double>(_count);
+        double variance = 0.0;
+        for (size_t i = 0; i < _count; ++i) {
+            variance += (_history[i] - mean) * (_history[i] - mean);
+        }
+        variance /= static_cast<double>(_count);
+
+        return {mean, variance, std::sqrt(variance), min, max};
+    }
+
+private:
+    void waitUntil(Clock::time_point deadline) {
+        static constexpr auto SLICE = std::chrono::milliseconds(1);
+
+        /// sleep in 1 ms slices while the remaining time exceeds the expected cost of one (mean + stddev)
+        while (true) {
+            const auto remaining = std::chrono::duration<double>(deadline - Clock::now()).count();
+            if (remaining <= _sleep_estimate) {
+                break;
+            }
+
+            const auto start = Clock::now();
+            std::this_thread::sleep_for(SLICE);
+            updateSleepEstimate(std::chrono::duration<double>(Clock::now() - start).count());
+        }
+
+        while (Clock::now() < deadline) {}
+    }
+
+    // Welford's running mean/variance of how long a 1 ms sleep really takes.
+    void updateSleepEstimate(double observed) {
+        _sleep_count += 1;
+        const auto delta = observed - _sleep_mean;
+        _sleep_mean += delta / static_cast<double>(_sleep_count);
+        _sleep_m2 += delta * (observed - _sleep_mean);
+
+        const auto stddev = std::sqrt(_sleep_m2 / static_cast<double>(_sleep_count));
+        _sleep_estimate = _sleep_mean + stddev;
+    }
+
+    Window& _window;
+    PacingMode _mode = PacingMode::VSync;
+    double _target_fps = 0.0;
+    bool _low_latency = false;
+
+    Clock::duration _period{};
+    Clock::time_point _deadline{};
+    Clock::time_point _last{};
+
+    std::array<double, HISTORY> _history{};
+    size_t _cursor = 0;
+    size_t _count = 0;
+
+    double _sleep_estimate = 0.005; /// seconds, refined as soon as the first sleep is measured
+    double _sleep_mean = 0.005;
+    double _sleep_m2 = 0.0;
+    uint64_t _sleep_count = 0;
+};
@@ -0,0 +1,402 @@
+#pragma once
+
+#include <GL/gl3w.h>
+#include <RenderContext.hpp>
+#include <MeshHeap.hpp>
+#include <OcclusionCuller.hpp>
+
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+#include <bit>
+
+#include <glm/gtc/type_ptr.hpp>
+
+// Mirrors `Object` in the culling and vertex shaders (std430).
+struct GpuObject {
+    glm::mat4 world;
+    glm::vec4 bounds_min; /// object space, w unused
+    glm::vec4 bounds_max;
+    glm::u32 first_index;
+    glm::u32 index_count;
+    glm::i32 base_vertex;
+    glm::u32 padding;
+};
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+struct GpuCullStats {
+    size_t submitted = 0;
+    size_t drawn = 0; /// read back without waiting, so it lags by FrameSync::depth() frames
+};
+
+// GPU-driven culling. Objects added during a frame are written to a persistently mapped SSBO; cull()
+// dispatches a compute pass that tests each one against the frustum of the camera UBO (binding 0) and
+// the OcclusionCuller's depth pyramid, and appends survivors to an indirect buffer through an atomic
+// counter. draw() then issues them with a single multi-draw. Each command's base_instance is the object
+// index, which reaches the vertex shader through an instanced attribute (see attach()), so neither
+// gl_DrawID nor gl_BaseInstance is needed. Without GL 4.6 the command buffer is cleared before culling
+// and drawn in full with glMultiDrawElementsIndirect; the unused tail is zero-count draws.
+struct GpuCuller {
+    static constexpr GLuint OBJECTS_BINDING = 0;  /// SSBO with GpuObjects, also read by the vertex shader
+    static constexpr GLuint COMMANDS_BINDING = 1;
+    static constexpr GLuint COUNTER_BINDING = 2;
+
+    explicit GpuCuller(RenderContext& renderContext, uint32_t capacity = 1 << 14)
+        : _sync(renderContext.frameSync)
+        , _memory(renderContext.memory) {
+        _shader = renderContext.createComputeShader(CULL_SHADER);
+        _slots.resize(FrameSync::MAX_DEPTH);
+
+        GLint major = 0;
+        GLint minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        _indirect_count = major > 4 || (major == 4 && minor >= 6);
+
+        glCreateBuffers(1, &_counter);
+        glNamedBufferStorage(_counter, sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        _memory.track(GpuResource::Buffer, _counter, GpuMemoryCategory::Other, sizeof(GLuint));
+
+        reserve(capacity);
+    }
+
+    ~GpuCuller() {
+        for (auto& slot : _slots) {
+            destroySlot(slot);
+        }
+        destroyBuffers();
+        _memory.release(GpuResource::Buffer, _counter);
+        glDeleteBuffers(1, &_counter);
+        glDeleteProgram(_shader);
+    }
+
+    GpuCuller(const GpuCuller&) = delete;
+    GpuCuller& operator=(const GpuCuller&) = delete;
+
+    // Adds a per-instance uint attribute holding the object index to `vao`; the vertex shader reads
+    // its GpuObject with it. The attribute is fed from a buffer of 0, 1, 2, ... with divisor 1.
+    void attach(GLuint vao, GLuint attribute, GLuint binding) {
+        glEnableVertexArrayAttrib(vao, attribute);
+        glVertexArrayAttribIFormat(vao, attribute, 1, GL_UNSIGNED_INT, 0);
+        glVertexArrayAttribBinding(vao, attribute, binding);
+        glVertexArrayBindingDivisor(vao, binding, 1);
+        glVertexArrayVertexBuffer(vao, binding, _ids, 0, sizeof(GLuint));
+        _attached.push_back(Attachment{vao, binding});
+    }
+
+    // Call once per frame before add().
+    void begin() {
+        auto& slot = _slots[_sync.index()];
+        if (slot.counter != nullptr && slot.frame != UINT64_MAX) {
+            /// FrameSync waited on this slot, so the counter copied back by that frame has landed
+            _stats.drawn = *slot.counter;
+        }
+        _objects.clear();
+    }
+
+    void add(const glm::mat4& world, const glm::vec3& min, const glm::vec3& max, const MeshRange& range) {
+        _objects.push_back(GpuObject{
+            world,
+            glm::vec4(min, 0.0f),
+            glm::vec4(max, 0.0f),
+            range.first_index,
+            range.index_count,
+            range.base_vertex,
+            0
+        });
+    }
+
+    // Expects the camera constants to be bound to uniform binding 0. Without `occlusion`, or before
+    // it has built a pyramid, only the frustum test runs.
+    void cull(const OcclusionCuller* occlusion = nullptr) {
+        const auto count = static_cast<uint32_t>(_objects.size());
+        _stats.submitted = count;
+        if (count > _capacity) {
+            reserve(std::bit_ceil(count));
+        }
+
+        auto& slot = _slots[_sync.index()];
+        const auto bytes = std::max<size_t>(count, 1) * sizeof(GpuObject);
+        if (slot.capacity < bytes) {
+            destroySlot(slot);
+            createSlot(slot, std::max(bytes, static_cast<size_t>(_capacity) * sizeof(GpuObject)));
+        }
+        std::memcpy(slot.objects, _objects.data(), count * sizeof(GpuObject));
+        slot.frame = _sync.frame();
+
+        static constexpr GLuint zero = 0;
+        glClearNamedBufferSubData(_counter, GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        if (!_indirect_count && count > 0) {
+            glClearNamedBufferSubData(_commands, GL_R32UI, 0, count * sizeof(DrawElementsIndirectCommand), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        }
+        _count = count;
+        if (count == 0) {
+            return;
+        }
+
+        const auto levels = occlusion != nullptr ? occlusion->levels() : 0;
+
+        glUseProgram(_shader);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECTS_BINDING, slot.buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, _commands);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, _counter);
+        glBindTextureUnit(0, levels > 0 ? occlusion->pyramid() : 0);
+        glUniform1ui(0, count);
+        glUniform1i(1, levels);
+        if (levels > 0) {
+            glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(occlusion->pyramidViewProjection()));
+        }
+        glDispatchCompute((count + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        glCopyNamedBufferSubData(_counter, slot.buffer, 0, static_cast<GLintptr>(slot.capacity), sizeof(GLuint));
+        glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+        glBindTextureUnit(0, 0);
+        glUseProgram(0);
+    }
+
+    // Expects the program and a VAO set up with attach() to be bound.
+    void draw(GLenum mode = GL_TRIANGLES) const {
+        if (_count == 0) {
+            return;
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECTS_BINDING, _slots[_sync.index()].buffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commands);
+        if (_indirect_count) {
+            glBindBuffer(GL_PARAMETER_BUFFER, _counter);
+            glMultiDrawElementsIndirectCount(mode, GL_UNSIGNED_INT, nullptr, 0, static_cast<GLsizei>(_count), 0);
+            glBindBuffer(GL_PARAMETER_BUFFER, 0);
+        } else {
+            glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(_count), 0);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // Whether draw() uses glMultiDrawElementsIndirectCount (GL 4.6) or the zero-count fallback.
+    bool indirectCount() const {
+        return _indirect_count;
+    }
+
+    const GpuCullStats& stats() const {
+        return _stats;
+    }
+
+private:
+    static constexpr std::string_view CULL_SHADER = R"(
+        #version 450
+
+        layout (local_size_x = 64) in;
+
+        struct Object {
+            mat4 world;
+            vec4 bounds_min;
+            vec4 bounds_max;
+            uint first_index;
+            uint index_count;
+            int base_vertex;
+            uint padding;
+        };
+
+        struct DrawCommand {
+            uint count;
+            uint instance_count;
+            uint first_index;
+            int base_vertex;
+            uint base_instance;
+        };
+
+        layout (binding = 0) uniform CameraConstants {
+            mat4 transform;
+            vec3 position;
+        } camera;
+
+        layout (std430, binding = 0) readonly buffer Objects {
+            Object objects[];
+        };
+
+        layout (std430, binding = 1) writeonly buffer Commands {
+            DrawCommand commands[];
+        };
+
+        layout (std430, binding = 2) buffer Counter {
+            uint draw_count;
+        };
+
+        layout (binding = 0) uniform sampler2D Pyramid;
+        layout (location = 0) uniform uint ObjectCount;
+        layout (location = 1) uniform int PyramidLevels;
+        layout (location = 2) uniform mat4 PyramidViewProjection;
+
+        vec4 corner(Object object, int i) {
+            return vec4(mix(object.bounds_min.xyz, object.bounds_max.xyz, bvec3(i & 1, i & 2, i & 4)), 1.0);
+        }
+
+        bool outsideFrustum(Object object) {
+            const mat4 mvp = camera.transform * object.world;
+            bool left = true;
+            bool right = true;
+            bool bottom = true;
+            bool top = true;
+            bool behind = true;
+            for (int i = 0; i < 8; ++i) {
+                const vec4 p = mvp * corner(object, i);
+                left = left && p.x < -p.w;
+                right = right && p.x > p.w;
+                bottom = bottom && p.y < -p.w;
+                top = top && p.y > p.w;
+                behind = behind && p.z > p.w;
+            }
+            return left || right || bottom || top || behind;
+        }
+
+        // Same test as OcclusionCuller::occluded, against the pyramid level where the footprint
+        // spans at most two texels.
+        bool occluded(Object object) {
+            const mat4 mvp = PyramidViewProjection * object.world;
+            vec2 lo = vec2(1.0);
+            vec2 hi = vec2(-1.0);
+            float nearest = 0.0;
+            for (int i = 0; i < 8; ++i) {
+                const vec4 p = mvp * corner(object, i);
+                if (p.w <= 0.0 || p.z > p.w) {
+                    return false;
+                }
+                const vec3 ndc = p.xyz / p.w;
+                lo = min(lo, ndc.xy);
+                hi = max(hi, ndc.xy);
+                nearest = max(nearest, ndc.z * 0.5 + 0.5);
+            }
+            if (any(lessThan(lo, vec2(-1.0))) || any(greaterThan(hi, vec2(1.0)))) {
+                return false;
+            }
+
+            const ivec2 size = textureSize(Pyramid, 0);
+            const ivec2 p0 = max(ivec2((lo * 0.5 + 0.5) * vec2(size)) - 1, ivec2(0));
+            const ivec2 p1 = min(ivec2((hi * 0.5 + 0.5) * vec2(size)) + 1, size - 1);
+            const int extent = max(p1.x - p0.x, p1.y - p0.y) + 1;
+            const int level = min(findMSB(max(extent - 1, 1)) + 1, PyramidLevels - 1);
+
+            const ivec2 last = textureSize(Pyramid, level) - 1;
+            const ivec2 t0 = min(p0 >> level, last);
+            const ivec2 t1 = min(p1 >> level, last);
+            for (int y = t0.y; y <= t1.y; ++y) {
+                for (int x = t0.x; x <= t1.x; ++x) {
+                    if (nearest >= texelFetch(Pyramid, ivec2(x, y), level).r) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void main() {
+            const uint index = gl_GlobalInvocationID.x;
+            if (index >= ObjectCount) {
+                return;
+            }
+
+            const Object object = objects[index];
+            if (outsideFrustum(object) || (PyramidLevels > 0 && occluded(object))) {
+                return;
+            }
+
+            const uint slot = atomicAdd(draw_count, 1);
+            commands[slot] = DrawCommand(object.index_count, 1u, object.first_index, object.base_vertex, index);
+        }
+    )";
+
+    struct Slot {
+        GLuint buffer = GL_NONE;
+        GpuObject* objects = nullptr;
+        const GLuint* counter = nullptr; /// one GLuint just past the objects
+        size_t capacity = 0;
+        uint64_t frame = UINT64_MAX;
+    };
+
+    struct Attachment {
+        GLuint vao;
+        GLuint binding;
+    };
+
+    void reserve(uint32_t capacity) {
+        destroyBuffers();
+        _capacity = capacity;
+
+        std::vector<GLuint> ids(capacity);
+        std::iota(ids.begin(), ids.end(), 0u);
+
+        glCreateBuffers(1, &_ids);
+        glNamedBufferStorage(_ids, static_cast<GLsizeiptr>(capacity * sizeof(GLuint)), ids.data(), 0);
+        _memory.track(GpuResource::Buffer, _ids, GpuMemoryCategory::Mesh, capacity * sizeof(GLuint));
+
+        glCreateBuffers(1, &_commands);
+        glNamedBufferStorage(_commands, static_cast<GLsizeiptr>(capacity * sizeof(DrawElementsIndirectCommand)), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        _memory.track(GpuResource::Buffer, _commands, GpuMemoryCategory::Other, capacity * sizeof(DrawElementsIndirectCommand));
+
+        for (const auto& attachment : _attached) {
+            glVertexArrayVertexBuffer(attachment.vao, attachment.binding, _ids, 0, sizeof(GLuint));
+        }
+    }
+
+    void destroyBuffers() {
+        if (_ids != GL_NONE) {
+            _memory.release(GpuResource::Buffer, _ids);
+            glDeleteBuffers(1, &_ids);
+            _ids = GL_NONE;
+        }
+        if (_commands != GL_NONE) {
+            _memory.release(GpuResource::Buffer, _commands);
+            glDeleteBuffers(1, &_commands);
+            _commands = GL_NONE;
+        }
+    }
+
+    void createSlot(Slot& slot, size_t bytes) {
+        static constexpr auto flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        const auto size = static_cast<GLsizeiptr>(bytes + sizeof(GLuint));
+        glCreateBuffers(1, &slot.buffer);
+        glNamedBufferStorage(slot.buffer, size, nullptr, flags);
+        auto pointer = static_cast<std::byte*>(glMapNamedBufferRange(slot.buffer, 0, size, flags));
+        slot.objects = reinterpret_cast<GpuObject*>(pointer);
+        slot.counter = reinterpret_cast<const GLuint*>(pointer + bytes);
+        slot.capacity = bytes;
+        _memory.track(GpuResource::Buffer, slot.buffer, GpuMemoryCategory::Staging, static_cast<size_t>(size));
+    }
+
+    void destroySlot(Slot& slot) {
+        if (slot.buffer != GL_NONE) {
+            _memory.release(GpuResource::Buffer, slot.buffer);
+            glUnmapNamedBuffer(slot.buffer);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+        slot = Slot{};
+    }
+
+    const FrameSync& _sync;
+    GpuMemoryRegistry& _memory;
+    GLuint _shader = GL_NONE;
+    bool _indirect_count = false;
+
+    GLuint _ids = GL_NONE;
+    GLuint _commands = GL_NONE;
+    GLuint _counter = GL_NONE;
+    uint32_t _capacity = 0;
+    uint32_t _count = 0;
+
+    std::vector<Slot> _slots{};
+    std::vector<Attachment> _attached{};
+    std::vector<GpuObject> _objects{};
+    GpuCullStats _stats{};
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <GL/gl3w.h>
+
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <array>
+#include <vector>
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+enum class GpuMemoryCategory : uint32_t {
+    Mesh,
+    RenderTarget,
+    Texture,
+    Uniform,
+    Staging,
+    Other,
+    Count
+};
+
+enum class GpuResource : uint32_t {
+    Buffer,
+    Texture,
+    Renderbuffer
+};
+
+struct GpuMemoryUsage {
+    size_t bytes = 0;
+    size_t high_water = 0;
+    size_t count = 0;
+};
+
+// Book-keeping for every buffer, texture and renderbuffer the application allocates. Owners report
+// their storage with track() (again on every reallocation) and drop it with release(); the registry
+// keeps per-category totals and high-water marks. With a budget set, enforceBudget() runs the eviction
+// callbacks, in the order they were added, until usage is back under it.
+struct GpuMemoryRegistry {
+    // Returns the number of bytes it released (through release()) for an excess of `excess` bytes.
+    using EvictionCallback = std::function<size_t(size_t excess)>;
+
+    static constexpr size_t CATEGORIES = static_cast<size_t>(GpuMemoryCategory::Count);
+
+    void track(GpuResource resource, GLuint handle, GpuMemoryCategory category, size_t bytes) {
+        const auto [it, inserted] = _allocations.try_emplace(key(resource, handle), Allocation{category, bytes});
+        if (!inserted) {
+            remove(it->second);
+            it->second = Allocation{category, bytes};
+        }
+        add(it->second);
+    }
+
+    void release(GpuResource resource, GLuint handle) {
+        if (auto it = _allocations.find(key(resource, handle)); it != _allocations.end()) {
+            remove(it->second);
+            _allocations.erase(it);
+        }
+    }
+
+    const GpuMemoryUsage& usage(GpuMemoryCategory category) const {
+        return _usage[static_cast<size_t>(category)];
+    }
+
+    const GpuMemoryUsage& total() const {
+        return _total;
+    }
+
+    // 0 disables the budget.
+    void setBudget(size_t bytes) {
+        _budget = bytes;
+    }
+
+    size_t budget() const {
+        return _budget;
+    }
+
+    void addEvictionCallback(EvictionCallback callback) {
+        _evictors.emplace_back(std::move(callback));
+    }
+
+    // Call between frames; returns whether usage is within the budget afterwards.
+    bool enforceBudget() {
+        if (_budget == 0) {
+            return true;
+        }
+        for (auto& evict : _evictors) {
+            if (_total.bytes <= _budget) {
+                break;
+            }
+            evict(_total.bytes - _budget);
+        }
+        return _total.bytes <= _budget;
+    }
+
+    static const char* name(GpuMemoryCategory category) {
+        switch (category) {
+            case GpuMemoryCategory::Mesh:
+                return "Mesh";
+            case GpuMemoryCategory::RenderTarget:
+                return "Render target";
+            case GpuMemoryCategory::Texture:
+                return "Texture";
+            case GpuMemoryCategory::Uniform:
+                return "Uniform";
+            case GpuMemoryCategory::Staging:
+                return "Staging";
+            default:
+                return "Other";
+        }
+    }
+
+    // Storage of an immutable texture; compressed formats are rounded up to whole 4x4 blocks.
+    static size_t textureBytes(GLenum format, GLsizei width, GLsizei height, GLsizei levels = 1, GLsizei layers = 1) {
+        const auto [block_bytes, block_size] = texelBlock(format);
+
+        size_t bytes = 0;
+        for (GLsizei level = 0; level < levels; ++level) {
+            const auto w = static_cast<size_t>(std::max(1, width >> level));
+            const auto h = static_cast<size_t>(std::max(1, height >> level));
+            bytes += (w + block_size - 1) / block_size * ((h + block_size - 1) / block_size) * block_bytes;
+        }
+        return bytes * static_cast<size_t>(layers);
+    }
+
+private:
+    struct Allocation {
+        GpuMemoryCategory category;
+        size_t bytes;
+    };
+
+    // Bytes per block and block edge in texels.
+    static std::pair<size_t, size_t> texelBlock(GLenum format) {
+        switch (format) {
+            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+                return {8, 4};
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+                return {16, 4};
+            case GL_R8:
+                return {1, 1};
+            case GL_RG8:
+            case GL_R16F:
+            case GL_DEPTH_COMPONENT16:
+                return {2, 1};
+            case GL_DEPTH32F_STENCIL8:
+            case GL_RGBA16F:
+            case GL_RG32F:
+                return {8, 1};
+            case GL_RGBA32F:
+                return {16, 1};
+            default:
+                /// RGBA8, RGB8 (padded by every driver), R32F, DEPTH24_STENCIL8, DEPTH_COMPONENT32F, ...
+                return {4, 1};
+        }
+    }
+
+    static uint64_t key(GpuResource resource, GLuint handle) {
+        return static_cast<uint64_t>(resource) << 32 | handle;
+    }
+
+    void add(const Allocation& allocation) {
+        for (auto usage : {&_usage[static_cast<size_t>(allocation.category)], &_total}) {
+            usage->bytes += allocation.bytes;
+            usage->count += 1;
+            usage->high_water = std::max(usage->high_water, usage->bytes);
+        }
+    }
+
+    void remove(const Allocation& allocation) {
+        for (auto usage : {&_usage[static_cast<size_t>(allocation.category)], &_total}) {
+            usage->bytes -= allocation.bytes;
+            usage->count -= 1;
+        }
+    }
+
+    std::unordered_map<uint64_t, Allocation> _allocations{};
+    std::array<GpuMemoryUsage, CATEGORIES> _usage{};
+    GpuMemoryUsage _total{};
+    size_t _budget = 0;
+    std::vector<EvictionCallback> _evictors{};
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <GL/gl3w.h>
+#include <RenderContext.hpp>
+#include <Mesh.hpp>
+#include <VoxelMesher.hpp>
+
+#include <string_view>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <span>
+
+// Output of GpuVoxelMesher: a vertex buffer of BlockVertex quads and the DrawElementsIndirect command
+// that draws them, both written by the compute pass.
+struct GpuChunkMesh {
+    GLuint vertices = GL_NONE;
+    GLuint command = GL_NONE;
+};
+
+// Meshes a VoxelChunk on the GPU. The voxels are uploaded as a packed SSBO (four per uint) and a compute
+// pass with one invocation per voxel appends a quad for each face that borders air, reserving space by
+// atomically adding to the command's index count, so the geometry never exists in CPU memory. Faces
+// use the same tables and colours as VoxelMesher. All quads share one index buffer of 0 1 2 0 2 3 + 4k.
+// A chunk with more than `max_faces` visible faces is truncated; faces() reports it.
+struct GpuVoxelMesher {
+    GpuVoxelMesher(
+        RenderContext& renderContext,
+        std::span<const VertexArrayAttrib> attributes,
+        std::span<const VertexArrayBinding> bindings,
+        uint32_t max_faces = 1 << 15
+    ) : _memory(renderContext.memory), _max_faces(max_faces) {
+        _shader = renderContext.createComputeShader(MESH_SHADER);
+
+        std::vector<uint32_t> indices{};
+        indices.reserve(static_cast<size_t>(max_faces) * 6);
+        for (uint32_t base = 0; base < max_faces * 4; base += 4) {
+            indices.insert(indices.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+        }
+        glCreateBuffers(1, &_indices);
+        glNamedBufferStorage(_indices, static_cast<GLsizeiptr>(indices.size() * sizeof(uint32_t)), indices.data(), 0);
+        _memory.track(GpuResource::Buffer, _indices, GpuMemoryCategory::Mesh, indices.size() * sizeof(uint32_t));
+
+        glCreateBuffers(1, &_voxels);
+        glNamedBufferStorage(_voxels, VoxelChunk::VOLUME, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        _memory.track(GpuResource::Buffer, _voxels, GpuMemoryCategory::Staging, VoxelChunk::VOLUME);
+
+        glCreateBuffers(1, &_palette);
+        glNamedBufferStorage(_palette, sizeof(VoxelPalette), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        _memory.track(GpuResource::Buffer, _palette, GpuMemoryCategory::Uniform, sizeof(VoxelPalette));
+
+        glCreateVertexArrays(1, &_vao);
+        for (const auto& attrib : attributes) {
+            glEnableVertexArrayAttrib(_vao, attrib.index);
+            glVertexArrayAttribFormat(_vao, attrib.index, attrib.size, attrib.type, attrib.normalized, attrib.offset);
+        }
+        for (const auto& binding : bindings) {
+            glVertexArrayAttribBinding(_vao, binding.index, binding.binding);
+        }
+        glVertexArrayElementBuffer(_vao, _indices);
+
+        glCreateQueries(GL_TIME_ELAPSED, 1, &_timer);
+    }
+
+    ~GpuVoxelMesher() {
+        glDeleteQueries(1, &_timer);
+        glDeleteVertexArrays(1, &_vao);
+        for (auto buffer : {_palette, _voxels, _indices}) {
+            _memory.release(GpuResource::Buffer, buffer);
+            glDeleteBuffers(1, &buffer);
+        }
+        glDeleteProgram(_shader);
+    }
+
+    GpuVoxelMesher(const GpuVoxelMesher&) = delete;
+    GpuVoxelMesher& operator=(const GpuVoxelMesher&) = delete;
+
+    GpuChunkMesh create() {
+        static constexpr DrawElementsCommand empty{0, 1, 0, 0, 0, 0};
+
+        GpuChunkMesh mesh{};
+        const auto vertex_bytes = static_cast<size_t>(_max_faces) * 4 * sizeof(BlockVertex);
+        glCreateBuffers(1, &mesh.vertices);
+        glNamedBufferStorage(mesh.vertices, static_cast<GLsizeiptr>(vertex_bytes), nullptr, 0);
+        _memory.track(GpuResource::Buffer, mesh.vertices, GpuMemoryCategory::Mesh, vertex_bytes);
+
+        glCreateBuffers(1, &mesh.command);
+        glNamedBufferStorage(mesh.command, sizeof(DrawElementsCommand), &empty, GL_DYNAMIC_STORAGE_BIT);
+        _memory.track(GpuResource::Buffer, mesh.command, GpuMemoryCategory::Mesh, sizeof(DrawElementsCommand));
+        return mesh;
+    }
+
+    void destroy(GpuChunkMesh& mesh) {
+        for (auto buffer : {mesh.vertices, mesh.command}) {
+            if (buffer != GL_NONE) {
+                _memory.release(GpuResource::Buffer, buffer);
+                glDeleteBuffers(1, &buffer);
+            }
+        }
+        mesh = GpuChunkMesh{};
+    }
+
+    void setPalette(const VoxelPalette& palette) {
+        glNamedBufferSubData(_palette, 0, sizeof(VoxelPalette), palette.data());
+    }
+
+    // Uploads `chunk` and records the compute pass that rebuilds `mesh`; nothing waits on the GPU.
+    void mesh(const VoxelChunk& chunk, GpuChunkMesh& mesh) {
+        static constexpr DrawElementsCommand empty{0, 1, 0, 0, 0, 0};
+
+        glNamedBufferSubData(_voxels, 0, VoxelChunk::VOLUME, chunk.voxels().data());
+        glNamedBufferSubData(mesh.command, 0, sizeof(DrawElementsCommand), &empty);
+
+        const auto timing = !_timer_pending;
+        if (timing) {
+            glBeginQuery(GL_TIME_ELAPSED, _timer);
+        }
+
+        glUseProgram(_shader);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _voxels);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mesh.vertices);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mesh.command);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 0, _palette);
+        glUniform1ui(0, _max_faces);
+
+        constexpr auto groups = static_cast<GLuint>(VoxelChunk::SIZE / 4);
+        glDispatchCompute(groups, groups, groups);
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        glUseProgram(0);
+
+        if (timing) {
+            glEndQuery(GL_TIME_ELAPSED);
+            _timer_pending = true;
+        }
+    }
+
+    // Expects the program to be bound; leaves the mesher's VAO bound.
+    void draw(const GpuChunkMesh& mesh) const {
+        glVertexArrayVertexBuffer(_vao, 0, mesh.vertices, 0, sizeof(BlockVertex));
+        glBindVertexArray(_vao);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mesh.command);
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // GPU time of the most recent timed mesh() in milliseconds; polls the timer query without blocking.
+    double gpuTime() {
+        if (_timer_pending) {
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(_timer, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(_timer, GL_QUERY_RESULT, &elapsed);
+                _gpu_time = static_cast<double>(elapsed) / 1e6;
+                _timer_pending = false;
+            }
+        }
+        return _gpu_time;
+    }
+
+    // Reads the mesh's face count and overflow flag back; this waits for the compute pass.
+    std::pair<uint32_t, bool> faces(const GpuChunkMesh& mesh) const {
+        DrawElementsCommand command{};
+        glGetNamedBufferSubData(mesh.command, 0, sizeof(DrawElementsCommand), &command);
+        return {command.count / 6, command.overflow != 0};
+    }
+
+private:
+    // glDrawElementsIndirect layout followed by the overflow flag written by the shader.
+    struct DrawElementsCommand {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+        GLuint overflow;
+    };
+
+    static constexpr std::string_view MESH_SHADER = R"(
+        #version 450
+
+        layout (local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+        const int SIZE = 32;
+
+        struct Vertex {
+            float x;
+            float y;
+            float z;
+            uint color;
+        };
+
+        layout (std430, binding = 0) readonly buffer Voxels {
+            uint voxels[];
+        };
+
+        layout (std430, binding = 1) writeonly buffer Vertices {
+            Vertex vertices[];
+        };
+
+        layout (std430, binding = 2) buffer Command {
+            uint count;
+            uint instance_count;
+            uint first_index;
+            int base_vertex;
+            uint base_instance;
+            uint overflow;
+        };
+
+        layout (std140, binding = 0) uniform Palette {
+            uvec4 colors[64];
+        };
+
+        layout (location = 0) uniform uint MaxFaces;
+
+        // same tables as detail::FACE_NORMALS, FACE_CORNERS and FACE_SHADE in VoxelMesher.hpp
+        const ivec3 NORMALS[6] = ivec3[6](
+            ivec3(0, 0, -1), ivec3(1, 0, 0), ivec3(0, 0, 1), ivec3(-1, 0, 0), ivec3(0, 1, 0), ivec3(0, -1, 0)
+        );
+
+        const ivec3 CORNERS[24] = ivec3[24](
+            ivec3(0, 0, 0), ivec3(0, 1, 0), ivec3(1, 1, 0), ivec3(1, 0, 0),
+            ivec3(1, 0, 0), ivec3(1, 1, 0), ivec3(1, 1, 1), ivec3(1, 0, 1),
+            ivec3(1, 0, 1), ivec3(1, 1, 1), ivec3(0, 1, 1), ivec3(0, 0, 1),
+            ivec3(0, 0, 1), ivec3(0, 1, 1), ivec3(0, 1, 0), ivec3(0, 0, 0),
+            ivec3(0, 1, 0), ivec3(0, 1, 1), ivec3(1, 1, 1), ivec3(1, 1, 0),
+            ivec3(0, 0, 1), ivec3(0, 0, 0), ivec3(1, 0, 0), ivec3(1, 0, 1)
+        );
+
+        const uint SHADE[6] = uint[6](204u, 204u, 204u, 204u, 255u, 153u);
+
+        uint voxel(ivec3 p) {
+            if (any(lessThan(p, ivec3(0))) || any(greaterThanEqual(p, ivec3(SIZE)))) {
+                return 0u;
+            }
+            const uint i = uint((p.y * SIZE + p.z) * SIZE + p.x);
+            return (voxels[i >> 2] >> ((i & 3u) * 8u)) & 0xFFu;
+        }
+
+        uint shade(uint color, uint s) {
+            const uvec4 c = (uvec4(color, color >> 8, color >> 16, color >> 24) & 0xFFu);
+            const uvec3 rgb = (c.rgb * s + 127u) / 255u;
+            return rgb.r | (rgb.g << 8) | (rgb.b << 16) | (c.a << 24);
+        }
+
+        void main() {
+            const ivec3 p = ivec3(gl_GlobalInvocationID);
+            const uint value = voxel(p);
+            if (value == 0u) {
+                return;
+            }
+            const uint color = colors[value >> 2][value & 3u];
+
+            for (int face = 0; face < 6; ++face) {
+                if (voxel(p + NORMALS[face]) != 0u) {
+                    continue;
+                }
+
+                const uint slot = atomicAdd(count, 6u) / 6u;
+                if (slot >= MaxFaces) {
+                    atomicAdd(count, 0u - 6u);
+                    overflow = 1u;
+                    continue;
+                }
+
+                const uint shaded = shade(color, SHADE[face]);
+                for (int corner = 0; corner < 4; ++corner) {
+                    const vec3 position = vec3(p + CORNERS[face * 4 + corner]);
+                    vertices[slot * 4u + uint(corner)] = Vertex(position.x, position.y, position.z, shaded);
+                }
+            }
+        }
+    )";
+
+    GpuMemoryRegistry& _memory;
+    uint32_t _max_faces;
+    GLuint _shader = GL_NONE;
+    GLuint _indices = GL_NONE;
+    GLuint _voxels = GL_NONE;
+    GLuint _palette = GL_NONE;
+    GLuint _vao = GL_NONE;
+
+    GLuint _timer = GL_NONE;
+    bool _timer_pending = false;
+    double _gpu_time = 0.0;
+};
@@ -12,6 +12,11 @@
 
 #include <GL/gl3w.h>
 #include <Mesh.hpp>
+#include <utils/hash.hpp>
+#include <AllocationTracker.hpp>
+
+#include <optional>
+#include <bit>
 
 struct ImGuiLayer {
     struct ImGuiContextDeleter {
@@ -51,8 +56,24 @@ struct ImGuiLayer {
     GLboolean last_enable_scissor_test;
     GLboolean last_enable_primitive_restart;
 
+    GpuMemoryRegistry* Memory = nullptr;
+    GLuint CacheTexture = GL_NONE;
+    GLuint CacheFramebuffer = GL_NONE;
+    GLuint CompositeShader = GL_NONE;
+    GLuint CompositeVao = GL_NONE;
+    glm::ivec2 CacheSize{};
+    std::optional<uint64_t> CacheHash{};
+    bool Retained = false;
+    bool Cached = false;
+
     ImGuiLayer(RenderContext& renderContext) {
         IMGUI_CHECKVERSION();
+        if constexpr (AllocationTracker::enabled) {
+            ImGui::SetAllocatorFunctions(
+                [](size_t size, void*) { return AllocationTracker::allocate(size); },
+                [](void* ptr, void*) { AllocationTracker::deallocate(ptr); }
+            );
+        }
         ctx.reset(ImGui::CreateContext());
 
         ImVec4* colors = ctx->Style.Colors;
@@ -138,6 +159,7 @@ struct ImGuiLayer {
         io.KeyMap[ImGuiKey_Y] = GLFW_KEY_Y;
         io.KeyMap[ImGuiKey_Z] = GLFW_KEY_Z;
 
+        Memory = &renderContext.memory;
         Init(renderContext, "#version 450");
         CreateDeviceObjects(renderContext);
     }
@@ -159,11 +181,40 @@ struct ImGuiLayer {
 
     void flush() {
         auto viewport = ctx->Viewports[0];
-        if (viewport->DrawDataP.Valid) {
+        if (!viewport->DrawDataP.Valid) {
+            return;
+        }
+        if (Retained) {
+            RenderRetained(viewport->DrawDataP);
+        } else {
             RenderDrawData(viewport->DrawDataP);
         }
     }
 
+    // In retained mode the UI is rasterised into an offscreen texture and only re-rendered when the
+    // hash of its vertex, index and command streams changes; otherwise the texture is composited.
+    void setRetained(bool enabled) {
+        Retained = enabled;
+        CacheHash.reset();
+    }
+
+    // Forces the next retained flush to re-render, e.g. after the contents of a texture shown with
+    // ImGui::Image changed without its handle changing.
+    void invalidate() {
+        CacheHash.reset();
+    }
+
+    // Whether the last flush composited the cached UI instead of replaying the draw commands.
+    bool cached() const {
+        return Cached;
+    }
+
+    // True while ImGui changes by itself between frames without new input: an item is being held or
+    // dragged, a window is moving, or a text field shows its blinking cursor.
+    bool animating() const {
+        return ctx->ActiveId != 0 || ctx->MovingWindow != nullptr || ctx->NavWindowingTarget != nullptr || ctx->IO.WantTextInput;
+    }
+
     void handleEvent(const KeyEvent& e) {
         auto& io = ctx->IO;
 
@@ -220,7 +271,18 @@ private:
             ShaderHandle = 0;
         }
 
+        DestroyCache();
+        if (CompositeShader != 0) {
+            glDeleteProgram(CompositeShader);
+            CompositeShader = 0;
+        }
+        if (CompositeVao != 0) {
+            glDeleteVertexArrays(1, &CompositeVao);
+            CompositeVao = 0;
+        }
+
         if (FontTexture != 0) {
+            Memory->release(GpuResource::Texture, FontTexture);
             glDeleteTextures(1, &FontTexture);
             io.Fonts->SetTexID(nullptr);
             FontTexture = 0;
@@ -358,6 +420,124 @@ private:
         RestoreRenderState();
     }
 
+    // nullopt when the UI contains user callbacks, whose output can't be known from the draw data.
+    static std::optional<uint64_t> HashDrawData(const ImDrawData& data) {
+        const float display[] = {
+            data.DisplayPos.x, data.DisplayPos.y,
+            data.DisplaySize.x, data.DisplaySize.y,
+            data.FramebufferScale.x, data.FramebufferScale.y
+        };
+        auto hash = Hash64::compute(display, sizeof(display));
+
+        for (const auto& cmd_list : std::span(data.CmdLists, data.CmdListsCount)) {
+            hash = Hash64::compute(cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), hash);
+            hash = Hash64::compute(cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), hash);
+
+            for (const auto& cmd : std::span(cmd_list->CmdBuffer.Data, cmd_list->CmdBuffer.Size)) {
+                if (cmd.UserCallback != nullptr && cmd.UserCallback != ImDrawCallback_ResetRenderState) {
+                    return std::nullopt;
+                }
+
+                /// field by field, ImDrawCmd has padding
+                const uint64_t fields[] = {
+                    std::bit_cast<uint32_t>(cmd.ClipRect.x),
+                    std::bit_cast<uint32_t>(cmd.ClipRect.y),
+                    std::bit_cast<uint32_t>(cmd.ClipRect.z),
+                    std::bit_cast<uint32_t>(cmd.ClipRect.w),
+                    static_cast<uint64_t>(reinterpret_cast<uintptr_t>(cmd.GetTexID())),
+                    cmd.VtxOffset,
+                    cmd.IdxOffset,
+                    cmd.ElemCount,
+                    cmd.UserCallback != nullptr
+                };
+                hash = Hash64::compute(fields, sizeof(fields), hash);
+            }
+        }
+        return hash;
+    }
+
+    void RenderRetained(ImDrawData& data) {
+        const auto fb_width = static_cast<int>(data.DisplaySize.x * data.FramebufferScale.x);
+        const auto fb_height = static_cast<int>(data.DisplaySize.y * data.FramebufferScale.y);
+        if (fb_width <= 0 || fb_height <= 0) {
+            return;
+        }
+
+        const auto hash = HashDrawData(data);
+        if (!hash) {
+            Cached = false;
+            RenderDrawData(data);
+            return;
+        }
+
+        if (CacheSize != glm::ivec2{fb_width, fb_height}) {
+            CreateCache(fb_width, fb_height);
+        }
+
+        Cached = CacheHash == hash;
+        if (!Cached) {
+            /// the regular blend state (src alpha / one, 1 - src alpha for alpha) accumulates premultiplied colour into a cleared target
+            GLint framebuffer = 0;
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, CacheFramebuffer);
+
+            const glm::vec4 transparent{0.0f};
+            glClearNamedFramebufferfv(CacheFramebuffer, GL_COLOR, 0, glm::value_ptr(transparent));
+            RenderDrawData(data);
+
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(framebuffer));
+            CacheHash = hash;
+        }
+
+        BackupRenderState();
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_STENCIL_TEST);
+        glDisable(GL_SCISSOR_TEST);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glViewport(0, 0, fb_width, fb_height);
+
+        glUseProgram(CompositeShader);
+        glBindTextureUnit(0, CacheTexture);
+        glBindSampler(0, 0);
+        glBindVertexArray(CompositeVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        RestoreRenderState();
+    }
+
+    void CreateCache(int width, int height) {
+        DestroyCache();
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &CacheTexture);
+        glTextureStorage2D(CacheTexture, 1, GL_RGBA8, width, height);
+        Memory->track(GpuResource::Texture, CacheTexture, GpuMemoryCategory::RenderTarget, GpuMemoryRegistry::textureBytes(GL_RGBA8, width, height));
+        glTextureParameteri(CacheTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(CacheTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glCreateFramebuffers(1, &CacheFramebuffer);
+        glNamedFramebufferTexture(CacheFramebuffer, GL_COLOR_ATTACHMENT0, CacheTexture, 0);
+
+        CacheSize = {width, height};
+        CacheHash.reset();
+    }
+
+    void DestroyCache() {
+        if (CacheFramebuffer != 0) {
+            glDeleteFramebuffers(1, &CacheFramebuffer);
+            CacheFramebuffer = 0;
+        }
+        if (CacheTexture != 0) {
+            Memory->release(GpuResource::Texture, CacheTexture);
+            glDeleteTextures(1, &CacheTexture);
+            CacheTexture = 0;
+        }
+        CacheSize = {};
+        CacheHash.reset();
+    }
+
     bool CreateFontsTexture() {
         auto Fonts = ctx->IO.Fonts;
 
@@ -367,6 +547,7 @@ private:
 
         glCreateTextures(GL_TEXTURE_2D, 1, &FontTexture);
         glTextureStorage2D(FontTexture, 1, GL_RGBA8, width, height);
+        Memory->track(GpuResource::Texture, FontTexture, GpuMemoryCategory::Texture, GpuMemoryRegistry::textureBytes(GL_RGBA8, width, height));
         glTextureParameteri(FontTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTextureParameteri(FontTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 //#ifdef GL_UNPACK_ROW_LENGTH
@@ -444,7 +625,35 @@ private:
             VertexArrayBinding{AttribLocationVtxColor, 0}
         };
 
-        mesh = std::make_unique<Mesh>(attributes, bindings, sizeof(ImDrawVert), GL_STREAM_DRAW);
+        mesh = std::make_unique<Mesh>(renderContext, attributes, bindings, sizeof(ImDrawVert), GL_STREAM_DRAW);
+
+        const auto composite_vertex_shader = R"(
+            #version 450
+
+            out gl_PerVertex {
+                vec4 gl_Position;
+            };
+
+            void main() {
+                const vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+                gl_Position = vec4(position * 2.0 - 1.0, 0, 1);
+            }
+        )"sv;
+
+        const auto composite_fragment_shader = R"(
+            #version 450
+
+            layout (location = 0) out vec4 Out_Color;
+
+            layout (binding = 0) uniform sampler2D Texture;
+
+            void main() {
+                Out_Color = texelFetch(Texture, ivec2(gl_FragCoord.xy), 0);
+            }
+        )"sv;
+
+        CompositeShader = renderContext.createShader(composite_vertex_shader, composite_fragment_shader);
+        glCreateVertexArrays(1, &CompositeVao);
 
         CreateFontsTexture();
         return true;
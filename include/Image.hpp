@@ -31,7 +31,7 @@ struct ImageData {
         _pixels[static_cast<size_t>(x) + static_cast<size_t>(y) * _info.width] = color;
     }
 
-    glm::u8vec4 get(glm::u32 x, glm::u32 y) {
+    glm::u8vec4 get(glm::u32 x, glm::u32 y) const {
         return _pixels[static_cast<size_t>(x) + static_cast<size_t>(y) * _info.width];
     }
 
@@ -43,6 +43,10 @@ struct ImageData {
         return _pixels;
     }
 
+    std::span<glm::u8vec4> pixels() {
+        return _pixels;
+    }
+
 private:
     ImageData() = default;
     ImageData(glm::u32 width, glm::u32 height)
@@ -53,70 +57,9 @@ private:
     std::vector<glm::u8vec4> _pixels{};
 };
 
-struct ImageExport {
-    static void save(const ImageData& data, const char* file_name) {
-        static constexpr auto BYTES_PER_PIXEL = sizeof(glm::u8vec4);
-        static constexpr auto FILE_HEADER_SIZE = 14;
-        static constexpr auto INFO_HEADER_SIZE = 40;
-
-        const auto [width, height] = data.info();
-        const auto pixels = std::as_bytes(data.pixels());
-        const auto widthInBytes = width * BYTES_PER_PIXEL;
-        const auto paddingSize = (4 - (widthInBytes) % 4) % 4;
-        const auto stride = widthInBytes + paddingSize;
-        const auto fileSize = FILE_HEADER_SIZE + INFO_HEADER_SIZE + (stride * height);
-
-        std::array<uint8_t, 3> padding = {0, 0, 0};
-
-        std::array<uint8_t, FILE_HEADER_SIZE + INFO_HEADER_SIZE> header{
-            'B', 'M', /// signature
-            0, 0, 0, 0, /// image file size in bytes
-            0, 0, 0, 0, /// reserved
-            0, 0, 0, 0, /// start of pixel array
-
-            0, 0, 0, 0, /// header size
-            0, 0, 0, 0, /// image width
-            0, 0, 0, 0, /// image height
-            0, 0,       /// number of color planes
-            0, 0,       /// bits per pixel
-            0, 0, 0, 0, /// compression
-            0, 0, 0, 0, /// image size
-            0, 0, 0, 0, /// horizontal resolution
-            0, 0, 0, 0, /// vertical resolution
-            0, 0, 0, 0, /// colors in color table
-            0, 0, 0, 0, /// important color count
-        };
-
-        header[2] = (unsigned char) (fileSize);
-        header[3] = (unsigned char) (fileSize >> 8);
-        header[4] = (unsigned char) (fileSize >> 16);
-        header[5] = (unsigned char) (fileSize >> 24);
-        header[10] = (unsigned char) (FILE_HEADER_SIZE + INFO_HEADER_SIZE);
-        header[14 + 0] = (unsigned char) (INFO_HEADER_SIZE);
-        header[14 + 4] = (unsigned char) (width);
-        header[14 + 5] = (unsigned char) (width >> 8);
-        header[14 + 6] = (unsigned char) (width >> 16);
-        header[14 + 7] = (unsigned char) (width >> 24);
-        header[14 + 8] = (unsigned char) (height);
-        header[14 + 9] = (unsigned char) (height >> 8);
-        header[14 + 10] = (unsigned char) (height >> 16);
-        header[14 + 11] = (unsigned char) (height >> 24);
-        header[14 + 12] = (unsigned char) (1);
-        header[14 + 14] = (unsigned char) (BYTES_PER_PIXEL * 8);
-
-        auto file = fopen(file_name, "wb");
-        fwrite(header.data(), 1, FILE_HEADER_SIZE + INFO_HEADER_SIZE, file);
-
-        for (int i = 0; i < height; i++) {
-            fwrite(pixels.subspan(i * widthInBytes).data(), BYTES_PER_PIXEL, width, file);
-            fwrite(padding.data(), 1, paddingSize, file);
-        }
-        fclose(file);
-    }
-};
-
 /*
     #include <glm/gtc/noise.hpp>
+    #include <ImageExport.hpp>
 
     std::array offsets {
         glm::vec2{0.0f, 0.0f},
@@ -0,0 +1,502 @@
+#pragma once
+
+#include <Image.hpp>
+#include <utils/parallel.hpp>
+
+#include <fmt/format.h>
+#include <string_view>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <array>
+
+template <typename T>
+concept ImageEncoder = requires(const ImageData& data) {
+    { T::encode(data) } -> std::same_as<std::vector<uint8_t>>;
+};
+
+namespace detail {
+    // Rows per strip for encoders that split the image into independently encoded pieces.
+    inline constexpr glm::u32 STRIP_ROWS = 64;
+
+    inline void put_u16le(uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value);
+        out[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    inline void put_u32le(uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value);
+        out[1] = static_cast<uint8_t>(value >> 8);
+        out[2] = static_cast<uint8_t>(value >> 16);
+        out[3] = static_cast<uint8_t>(value >> 24);
+    }
+
+    inline void put_u32be(uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value >> 24);
+        out[1] = static_cast<uint8_t>(value >> 16);
+        out[2] = static_cast<uint8_t>(value >> 8);
+        out[3] = static_cast<uint8_t>(value);
+    }
+
+    inline void append_u32be(std::vector<uint8_t>& out, uint32_t value) {
+        const auto offset = out.size();
+        out.resize(offset + 4);
+        put_u32be(out.data() + offset, value);
+    }
+
+    // Slicing-by-8 CRC-32 as used by PNG chunks.
+    struct Crc32 {
+        std::array<std::array<uint32_t, 256>, 8> table{};
+
+        constexpr Crc32() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+                }
+                table[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; ++i) {
+                for (size_t t = 1; t < 8; ++t) {
+                    table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+                }
+            }
+        }
+
+        uint32_t update(uint32_t crc, const uint8_t* data, size_t size) const {
+            crc = ~crc;
+            while (size >= 8) {
+                const uint32_t lo = crc ^ (uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24);
+                const uint32_t hi = uint32_t(data[4]) | uint32_t(data[5]) << 8 | uint32_t(data[6]) << 16 | uint32_t(data[7]) << 24;
+                crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^ table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24]
+                    ^ table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^ table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+                data += 8;
+                size -= 8;
+            }
+            while (size-- > 0) {
+                crc = table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+    };
+
+    inline constexpr Crc32 CRC32{};
+
+    inline constexpr uint32_t ADLER_BASE = 65521;
+
+    inline uint32_t adler32(uint32_t adler, const uint8_t* data, size_t size) {
+        uint32_t a = adler & 0xFFFF;
+        uint32_t b = adler >> 16;
+        while (size > 0) {
+            const auto n = std::min<size_t>(size, 5552);
+            for (size_t i = 0; i < n; ++i) {
+                a += data[i];
+                b += a;
+            }
+            a %= ADLER_BASE;
+            b %= ADLER_BASE;
+            data += n;
+            size -= n;
+        }
+        return a | (b << 16);
+    }
+
+    // Checksum of two concatenated pieces from their separate checksums, as zlib's adler32_combine.
+    inline uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t size2) {
+        const auto rem = static_cast<uint32_t>(size2 % ADLER_BASE);
+        uint32_t sum1 = adler1 & 0xFFFF;
+        uint32_t sum2 = static_cast<uint32_t>((uint64_t(rem) * sum1) % ADLER_BASE);
+        sum1 += (adler2 & 0xFFFF) + ADLER_BASE - 1;
+        sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+        if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+        if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+        if (sum2 >= (ADLER_BASE << 1)) sum2 -= (ADLER_BASE << 1);
+        if (sum2 >= ADLER_BASE) sum2 -= ADLER_BASE;
+        return sum1 | (sum2 << 16);
+    }
+
+    // LSB-first bit writer for deflate streams.
+    struct BitWriter {
+        std::vector<uint8_t>& out;
+        uint64_t bits = 0;
+        uint32_t count = 0;
+
+        void put(uint32_t value, uint32_t length) {
+            bits |= uint64_t(value) << count;
+            count += length;
+            while (count >= 8) {
+                out.push_back(static_cast<uint8_t>(bits));
+                bits >>= 8;
+                count -= 8;
+            }
+        }
+
+        // Huffman codes are defined MSB-first.
+        void putReversed(uint32_t code, uint32_t length) {
+            uint32_t reversed = 0;
+            for (uint32_t i = 0; i < length; ++i) {
+                reversed = (reversed << 1) | ((code >> i) & 1);
+            }
+            put(reversed, length);
+        }
+
+        void align() {
+            if (count > 0) {
+                put(0, 8 - count);
+            }
+        }
+    };
+}
+
+// Uncompressed top-down 32-bit BMP. Rows are swizzled to BGRA in parallel strips.
+struct BmpEncoder {
+    static std::vector<uint8_t> encode(const ImageData& data) {
+        static constexpr size_t FILE_HEADER_SIZE = 14;
+        static constexpr size_t INFO_HEADER_SIZE = 40;
+        static constexpr size_t HEADER_SIZE = FILE_HEADER_SIZE + INFO_HEADER_SIZE;
+
+        const auto [width, height] = data.info();
+        const auto pixels = data.pixels();
+        const auto stride = size_t(width) * sizeof(glm::u8vec4);
+        const auto fileSize = HEADER_SIZE + stride * height;
+
+        std::vector<uint8_t> out(fileSize);
+
+        uint8_t* header = out.data();
+        header[0] = 'B';
+        header[1] = 'M';
+        detail::put_u32le(header + 2, static_cast<uint32_t>(fileSize));
+        detail::put_u32le(header + 10, HEADER_SIZE);
+        detail::put_u32le(header + 14, INFO_HEADER_SIZE);
+        detail::put_u32le(header + 18, width);
+        detail::put_u32le(header + 22, static_cast<uint32_t>(-static_cast<int32_t>(height))); /// negative height: rows are stored top-down
+        detail::put_u16le(header + 26, 1);
+        detail::put_u16le(header + 28, sizeof(glm::u8vec4) * 8);
+
+        const auto strips = (height + detail::STRIP_ROWS - 1) / detail::STRIP_ROWS;
+        parallelFor(strips, [&](size_t strip) {
+            const auto y0 = strip * detail::STRIP_ROWS;
+            const auto y1 = std::min<size_t>(y0 + detail::STRIP_ROWS, height);
+
+            auto dst = out.data() + HEADER_SIZE + y0 * stride;
+            for (const auto& pixel : pixels.subspan(y0 * width, (y1 - y0) * width)) {
+                dst[0] = pixel.z;
+                dst[1] = pixel.y;
+                dst[2] = pixel.x;
+                dst[3] = pixel.w;
+                dst += 4;
+            }
+        });
+        return out;
+    }
+};
+
+// Lossless QOI (https://qoiformat.org). The format chains state through every pixel, so it encodes serially.
+struct QoiEncoder {
+    static std::vector<uint8_t> encode(const ImageData& data) {
+        static constexpr uint8_t QOI_OP_INDEX = 0x00;
+        static constexpr uint8_t QOI_OP_DIFF = 0x40;
+        static constexpr uint8_t QOI_OP_LUMA = 0x80;
+        static constexpr uint8_t QOI_OP_RUN = 0xC0;
+        static constexpr uint8_t QOI_OP_RGB = 0xFE;
+        static constexpr uint8_t QOI_OP_RGBA = 0xFF;
+        static constexpr std::array<uint8_t, 8> END_MARKER{0, 0, 0, 0, 0, 0, 0, 1};
+
+        const auto [width, height] = data.info();
+        const auto pixels = data.pixels();
+
+        std::vector<uint8_t> out(14 + pixels.size() * 5 + END_MARKER.size());
+        auto dst = out.data();
+
+        std::memcpy(dst, "qoif", 4);
+        detail::put_u32be(dst + 4, width);
+        detail::put_u32be(dst + 8, height);
+        dst[12] = 4; /// channels
+        dst[13] = 0; /// sRGB with linear alpha
+        dst += 14;
+
+        std::array<glm::u8vec4, 64> index{};
+        glm::u8vec4 prev{0, 0, 0, 255};
+        uint32_t run = 0;
+
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            const auto px = pixels[i];
+
+            if (px == prev) {
+                run += 1;
+                if (run == 62 || i + 1 == pixels.size()) {
+                    *dst++ = QOI_OP_RUN | static_cast<uint8_t>(run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0) {
+                *dst++ = QOI_OP_RUN | static_cast<uint8_t>(run - 1);
+                run = 0;
+            }
+
+            const auto hash = (px.x * 3 + px.y * 5 + px.z * 7 + px.w * 11) % 64;
+            if (index[hash] == px) {
+                *dst++ = QOI_OP_INDEX | static_cast<uint8_t>(hash);
+            } else {
+                index[hash] = px;
+
+                if (px.w == prev.w) {
+                    const auto vr = static_cast<int8_t>(px.x - prev.x);
+                    const auto vg = static_cast<int8_t>(px.y - prev.y);
+                    const auto vb = static_cast<int8_t>(px.z - prev.z);
+                    const auto vg_r = static_cast<int8_t>(vr - vg);
+                    const auto vg_b = static_cast<int8_t>(vb - vg);
+
+                    if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                        *dst++ = QOI_OP_DIFF | static_cast<uint8_t>((vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                    } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+                        *dst++ = QOI_OP_LUMA | static_cast<uint8_t>(vg + 32);
+                        *dst++ = static_cast<uint8_t>((vg_r + 8) << 4 | (vg_b + 8));
+                    } else {
+                        *dst++ = QOI_OP_RGB;
+                        *dst++ = px.x;
+                        *dst++ = px.y;
+                        *dst++ = px.z;
+                    }
+                } else {
+                    *dst++ = QOI_OP_RGBA;
+                    *dst++ = px.x;
+                    *dst++ = px.y;
+                    *dst++ = px.z;
+                    *dst++ = px.w;
+                }
+            }
+            prev = px;
+        }
+
+        std::memcpy(dst, END_MARKER.data(), END_MARKER.size());
+        dst += END_MARKER.size();
+
+        out.resize(static_cast<size_t>(dst - out.data()));
+        return out;
+    }
+};
+
+// 8-bit RGBA PNG with a built-in deflate coder: fixed Huffman codes and only two match distances,
+// the previous pixel (runs) and the previous row (vertical repeats). No zlib dependency.
+// Each strip of rows is coded as its own byte-aligned deflate block and IDAT chunk, so strips
+// encode in parallel and are stitched together with a combined Adler-32.
+struct PngEncoder {
+    static std::vector<uint8_t> encode(const ImageData& data) {
+        static constexpr std::array<uint8_t, 8> SIGNATURE{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+        const auto [width, height] = data.info();
+        const auto row_size = 1 + size_t(width) * sizeof(glm::u8vec4);
+        const auto strips = std::max<size_t>(1, (height + detail::STRIP_ROWS - 1) / detail::STRIP_ROWS);
+
+        struct Strip {
+            std::vector<uint8_t> chunk{};
+            uint32_t adler = 1;
+            size_t raw_size = 0;
+        };
+        std::vector<Strip> encoded(strips);
+
+        parallelFor(strips, [&](size_t strip) {
+            const auto y0 = std::min<size_t>(strip * detail::STRIP_ROWS, height);
+            const auto y1 = std::min<size_t>(y0 + detail::STRIP_ROWS, height);
+
+            std::vector<uint8_t> raw((y1 - y0) * row_size);
+            for (size_t y = y0; y < y1; ++y) {
+                auto row = raw.data() + (y - y0) * row_size;
+                row[0] = 0; /// filter: none
+                std::memcpy(row + 1, data.pixels().subspan(y * width, width).data(), width * sizeof(glm::u8vec4));
+            }
+
+            auto& out = encoded[strip];
+            out.raw_size = raw.size();
+            out.adler = detail::adler32(1, raw.data(), raw.size());
+
+            out.chunk.reserve(raw.size() / 2 + 64);
+            out.chunk.resize(8);
+            std::memcpy(out.chunk.data() + 4, "IDAT", 4);
+            if (strip == 0) {
+                out.chunk.push_back(0x78); /// zlib header: deflate, 32K window
+                out.chunk.push_back(0x01);
+            }
+            deflate(out.chunk, raw, row_size, strip + 1 == strips);
+            if (strip + 1 == strips) {
+                /// trailer is patched in once every strip's checksum is known
+                out.chunk.resize(out.chunk.size() + 4);
+            }
+        });
+
+        uint32_t adler = encoded[0].adler;
+        for (size_t i = 1; i < strips; ++i) {
+            adler = detail::adler32_combine(adler, encoded[i].adler, encoded[i].raw_size);
+        }
+
+        /// chunk lengths and crcs
+        auto& last = encoded.back().chunk;
+        detail::put_u32be(last.data() + last.size() - 4, adler);
+        parallelFor(strips, [&](size_t strip) {
+            auto& chunk = encoded[strip].chunk;
+            detail::put_u32be(chunk.data(), static_cast<uint32_t>(chunk.size() - 8));
+            detail::append_u32be(chunk, detail::CRC32.update(0, chunk.data() + 4, chunk.size() - 4));
+        });
+
+        std::array<uint8_t, 13> ihdr{};
+        detail::put_u32be(ihdr.data() + 0, width);
+        detail::put_u32be(ihdr.data() + 4, height);
+        ihdr[8] = 8;  /// bit depth
+        ihdr[9] = 6;  /// color type: RGBA
+        ihdr[10] = 0; /// compression
+        ihdr[11] = 0; /// filter
+        ihdr[12] = 0; /// interlace
+
+        size_t total = SIGNATURE.size() + (12 + ihdr.size()) + 12;
+        for (const auto& strip : encoded) {
+            total += strip.chunk.size();
+        }
+
+        std::vector<uint8_t> out{};
+        out.reserve(total);
+        out.insert(out.end(), SIGNATURE.begin(), SIGNATURE.end());
+        writeChunk(out, "IHDR", ihdr);
+        for (const auto& strip : encoded) {
+            out.insert(out.end(), strip.chunk.begin(), strip.chunk.end());
+        }
+        writeChunk(out, "IEND", {});
+        return out;
+    }
+
+private:
+    static void writeChunk(std::vector<uint8_t>& out, const char (&type)[5], std::span<const uint8_t> payload) {
+        const auto offset = out.size();
+        detail::append_u32be(out, static_cast<uint32_t>(payload.size()));
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), payload.begin(), payload.end());
+        detail::append_u32be(out, detail::CRC32.update(0, out.data() + offset + 4, payload.size() + 4));
+    }
+
+    static void putLiteral(detail::BitWriter& writer, uint32_t value) {
+        if (value < 144) {
+            writer.putReversed(0x30 + value, 8);
+        } else {
+            writer.putReversed(0x190 + (value - 144), 9);
+        }
+    }
+
+    static void putSymbol(detail::BitWriter& writer, uint32_t symbol) {
+        if (symbol < 280) {
+            writer.putReversed(symbol - 256, 7);
+        } else {
+            writer.putReversed(0xC0 + (symbol - 280), 8);
+        }
+    }
+
+    static void putLength(detail::BitWriter& writer, uint32_t length) {
+        static constexpr std::array<uint16_t, 29> BASE{3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static constexpr std::array<uint8_t, 29> EXTRA{0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+        size_t code = 28;
+        while (BASE[code] > length) {
+            code -= 1;
+        }
+        putSymbol(writer, static_cast<uint32_t>(257 + code));
+        writer.put(length - BASE[code], EXTRA[code]);
+    }
+
+    static void putDistance(detail::BitWriter& writer, uint32_t distance) {
+        static constexpr std::array<uint16_t, 30> BASE{1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static constexpr std::array<uint8_t, 30> EXTRA{0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        size_t code = 29;
+        while (BASE[code] > distance) {
+            code -= 1;
+        }
+        writer.putReversed(static_cast<uint32_t>(code), 5);
+        writer.put(distance - BASE[code], EXTRA[code]);
+    }
+
+    static size_t matchLength(std::span<const uint8_t> raw, size_t pos, size_t distance) {
+        if (distance == 0 || distance > pos || distance > 32768) {
+            return 0;
+        }
+        const auto limit = std::min<size_t>(258, raw.size() - pos);
+        size_t length = 0;
+        while (length < limit && raw[pos + length] == raw[pos + length - distance]) {
+            length += 1;
+        }
+        return length;
+    }
+
+    static void deflate(std::vector<uint8_t>& out, std::span<const uint8_t> raw, size_t row_size, bool final) {
+        static constexpr size_t MIN_MATCH = 3;
+
+        detail::BitWriter writer{out};
+        writer.put(final ? 1 : 0, 1); /// BFINAL
+        writer.put(1, 2);             /// BTYPE: fixed Huffman
+
+        size_t pos = 0;
+        while (pos < raw.size()) {
+            const auto run = matchLength(raw, pos, sizeof(glm::u8vec4));
+            const auto up = matchLength(raw, pos, row_size);
+            const auto [length, distance] = up > run ? std::pair{up, row_size} : std::pair{run, sizeof(glm::u8vec4)};
+
+            if (length >= MIN_MATCH) {
+                putLength(writer, static_cast<uint32_t>(length));
+                putDistance(writer, static_cast<uint32_t>(distance));
+                pos += length;
+            } else {
+                putLiteral(writer, raw[pos]);
+                pos += 1;
+            }
+        }
+        putSymbol(writer, 256); /// end of block
+
+        if (!final) {
+            /// empty stored block, byte-aligns the stream so the next strip can be appended as is
+            writer.put(0, 3);
+            writer.align();
+            out.insert(out.end(), {0x00, 0x00, 0xFF, 0xFF});
+        } else {
+            writer.align();
+        }
+    }
+};
+
+struct ImageExport {
+    template <ImageEncoder Encoder>
+    static bool save(const ImageData& data, const char* file_name) {
+        return write(Encoder::encode(data), file_name);
+    }
+
+    // Picks the encoder from the file extension (.png, .qoi, otherwise .bmp).
+    static bool save(const ImageData& data, const char* file_name) {
+        const std::string_view name{file_name};
+        if (name.ends_with(".png")) {
+            return save<PngEncoder>(data, file_name);
+        }
+        if (name.ends_with(".qoi")) {
+            return save<QoiEncoder>(data, file_name);
+        }
+        return save<BmpEncoder>(data, file_name);
+    }
+
+    // The whole encoded image goes out in a single unbuffered write.
+    static bool write(std::span<const uint8_t> bytes, const char* file_name) {
+        auto file = std::fopen(file_name, "wb");
+        if (file == nullptr) {
+            fmt::print("Failed to open '{}' for writing\n", file_name);
+            return false;
+        }
+        std::setvbuf(file, nullptr, _IONBF, 0);
+
+        const auto written = std::fwrite(bytes.data(), 1, bytes.size(), file);
+        const auto closed = std::fclose(file) == 0;
+        if (written != bytes.size() || !closed) {
+            fmt::print("Failed to write '{}'\n", file_name);
+            return false;
+        }
+        return true;
+    }
+};
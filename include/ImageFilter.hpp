@@ -0,0 +1,383 @@
+#pragma once
+
+#include <Image.hpp>
+#include <utils/parallel.hpp>
+
+#include <algorithm>
+#include <numbers>
+#include <vector>
+#include <array>
+#include <cmath>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_FILTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+enum class ResampleFilter {
+    Box,      /// 2x2 average, tiled single pass over the base level
+    Lanczos3, /// 12-tap separable windowed sinc
+    Kaiser    /// 12-tap separable Kaiser-windowed sinc (alpha = 4), less ringing than Lanczos
+};
+
+struct MipChainOptions {
+    ResampleFilter filter = ResampleFilter::Box;
+    bool srgb = true;         /// filter colour channels in linear space
+    bool premultiply = false; /// output premultiplied alpha
+};
+
+namespace detail {
+    // One RGBA texel in linear float, four lanes wide.
+    struct Texel {
+#ifdef IMAGE_FILTER_SSE2
+        __m128 v;
+
+        static Texel zero() { return {_mm_setzero_ps()}; }
+        static Texel splat(float s) { return {_mm_set1_ps(s)}; }
+        static Texel load(const float* p) { return {_mm_loadu_ps(p)}; }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+
+        friend Texel operator+(Texel a, Texel b) { return {_mm_add_ps(a.v, b.v)}; }
+        friend Texel operator*(Texel a, Texel b) { return {_mm_mul_ps(a.v, b.v)}; }
+        friend Texel clamp01(Texel a) { return {_mm_min_ps(_mm_max_ps(a.v, _mm_setzero_ps()), _mm_set1_ps(1.0f))}; }
+#else
+        glm::vec4 v;
+
+        static Texel zero() { return {glm::vec4(0.0f)}; }
+        static Texel splat(float s) { return {glm::vec4(s)}; }
+        static Texel load(const float* p) { return {glm::vec4(p[0], p[1], p[2], p[3])}; }
+        void store(float* p) const { p[0] = v.x; p[1] = v.y; p[2] = v.z; p[3] = v.w; }
+
+        friend Texel operator+(Texel a, Texel b) { return {a.v + b.v}; }
+        friend Texel operator*(Texel a, Texel b) { return {a.v * b.v}; }
+        friend Texel clamp01(Texel a) { return {glm::clamp(a.v, 0.0f, 1.0f)}; }
+#endif
+    };
+
+    struct SrgbTables {
+        static constexpr size_t ENCODE_BITS = 12;
+
+        std::array<float, 256> decode{};
+        std::array<float, 256> unorm{};
+        std::array<uint8_t, 1 << ENCODE_BITS> encode{};
+
+        SrgbTables() {
+            for (size_t i = 0; i < decode.size(); ++i) {
+                const auto c = static_cast<float>(i) / 255.0f;
+                decode[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                unorm[i] = c;
+            }
+            for (size_t i = 0; i < encode.size(); ++i) {
+                const auto l = static_cast<float>(i) / static_cast<float>(encode.size() - 1);
+                const auto c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                encode[i] = static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+
+        static const SrgbTables& get() {
+            static const SrgbTables tables{};
+            return tables;
+        }
+    };
+}
+
+// CPU resampling and conversion kernels for ImageData. All float intermediates are linear RGBA in [0, 1].
+struct ImageFilter {
+    static void srgbToLinear(std::span<const glm::u8vec4> src, std::span<glm::vec4> dst, bool srgb = true, bool premultiply = false) {
+        const auto& tables = detail::SrgbTables::get();
+        const auto& rgb = srgb ? tables.decode : tables.unorm;
+
+        for (size_t i = 0; i < src.size(); ++i) {
+            const auto& px = src[i];
+            const auto a = tables.unorm[px.w];
+            const auto m = premultiply ? a : 1.0f;
+            dst[i] = glm::vec4(rgb[px.x] * m, rgb[px.y] * m, rgb[px.z] * m, a);
+        }
+    }
+
+    static void linearToSrgb(std::span<const glm::vec4> src, std::span<glm::u8vec4> dst, bool srgb = true) {
+        static constexpr auto scale = static_cast<float>((1 << detail::SrgbTables::ENCODE_BITS) - 1);
+        const auto& tables = detail::SrgbTables::get();
+
+        for (size_t i = 0; i < src.size(); ++i) {
+            const auto px = glm::clamp(src[i], 0.0f, 1.0f);
+            if (srgb) {
+                dst[i] = glm::u8vec4(
+                    tables.encode[static_cast<size_t>(px.x * scale + 0.5f)],
+                    tables.encode[static_cast<size_t>(px.y * scale + 0.5f)],
+                    tables.encode[static_cast<size_t>(px.z * scale + 0.5f)],
+                    static_cast<uint8_t>(px.w * 255.0f + 0.5f)
+                );
+            } else {
+                dst[i] = glm::u8vec4(px * 255.0f + 0.5f);
+            }
+        }
+    }
+
+    // rgb = rgb * a / 255 with exact rounding, in place.
+    static void premultiplyAlpha(ImageData& image) {
+        auto pixels = image.pixels();
+        auto bytes = reinterpret_cast<uint8_t*>(pixels.data());
+        size_t i = 0;
+
+#ifdef IMAGE_FILTER_SSE2
+        const auto alpha_mask = _mm_set1_epi64x(static_cast<int64_t>(0xFFFF000000000000ull));
+        const auto bias = _mm_set1_epi16(128);
+        for (; i + 4 <= pixels.size(); i += 4) {
+            const auto src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i * 4));
+            __m128i halves[2] = {
+                _mm_unpacklo_epi8(src, _mm_setzero_si128()),
+                _mm_unpackhi_epi8(src, _mm_setzero_si128())
+            };
+            for (auto& c : halves) {
+                const auto a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, 0xFF), 0xFF);
+                auto t = _mm_add_epi16(_mm_mullo_epi16(c, a), bias);
+                t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+                c = _mm_or_si128(_mm_andnot_si128(alpha_mask, t), _mm_and_si128(alpha_mask, c));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i * 4), _mm_packus_epi16(halves[0], halves[1]));
+        }
+#endif
+        for (; i < pixels.size(); ++i) {
+            auto& px = pixels[i];
+            const auto mul = [a = px.w](uint8_t c) {
+                const auto t = static_cast<uint32_t>(c) * a + 128;
+                return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+            };
+            px = glm::u8vec4(mul(px.x), mul(px.y), mul(px.z), px.w);
+        }
+    }
+
+    // Next mip level: floor(size / 2), at least 1.
+    static ImageData downsample(const ImageData& src, const MipChainOptions& options = {}) {
+        const auto [width, height] = src.info();
+        const auto [dst_width, dst_height] = nextLevel({width, height});
+
+        std::vector<glm::vec4> linear(static_cast<size_t>(width) * height);
+        decodeRows(src, linear, 0, height, options);
+
+        std::vector<glm::vec4> result(static_cast<size_t>(dst_width) * dst_height);
+        if (options.filter == ResampleFilter::Box) {
+            parallelFor(dst_height, [&](size_t y) {
+                boxRow(linear.data(), width, height, result.data() + y * dst_width, dst_width, static_cast<glm::u32>(y));
+            });
+        } else {
+            resample(linear, {width, height}, result, {dst_width, dst_height}, options.filter);
+        }
+
+        auto dst = ImageData::create(dst_width, dst_height);
+        encodeRows(result, dst, 0, dst_height, options);
+        return dst;
+    }
+
+    // Full chain including the base level. With the box filter the base level is walked once in
+    // TILE x TILE blocks that stay cache resident while every level they cover is produced, so tiles
+    // (and with them all levels) are processed in parallel. Windowed-sinc filters need neighbouring
+    // texels and run level by level, parallel over rows.
+    static std::vector<ImageData> buildMipChain(const ImageData& base, const MipChainOptions& options = {}) {
+        static constexpr glm::u32 TILE = 64;
+        static constexpr auto TILE_LEVELS = static_cast<size_t>(std::bit_width(TILE) - 1);
+
+        const auto [width, height] = base.info();
+        const auto count = static_cast<size_t>(std::bit_width(std::max(width, height)));
+
+        std::vector<ImageData> levels{};
+        levels.reserve(count);
+
+        if (options.premultiply) {
+            auto copy = base;
+            premultiplyBase(copy, options);
+            levels.push_back(std::move(copy));
+        } else {
+            levels.push_back(base);
+        }
+
+        if (options.filter != ResampleFilter::Box) {
+            for (size_t i = 1; i < count; ++i) {
+                levels.push_back(downsample(levels.back(), {options.filter, options.srgb, false}));
+            }
+            return levels;
+        }
+
+        std::vector<ImageInfo> sizes{ImageInfo{width, height}};
+        for (size_t i = 1; i < count; ++i) {
+            sizes.push_back(nextLevel(sizes.back()));
+            levels.push_back(ImageData::create(sizes.back().width, sizes.back().height));
+        }
+
+        const auto tiled = std::min(TILE_LEVELS, count - 1);
+        const auto tiles_x = (width + TILE - 1) / TILE;
+        const auto tiles_y = (height + TILE - 1) / TILE;
+
+        parallelFor(static_cast<size_t>(tiles_x) * tiles_y, [&](size_t tile) {
+            const auto tx = static_cast<glm::u32>(tile % tiles_x) * TILE;
+            const auto ty = static_cast<glm::u32>(tile / tiles_x) * TILE;
+
+            std::vector<glm::vec4> buffer(static_cast<size_t>(TILE) * TILE);
+            glm::u32 w = std::min(TILE, width - tx);
+            glm::u32 h = std::min(TILE, height - ty);
+
+            const auto source = levels[0].pixels();
+            for (glm::u32 y = 0; y < h; ++y) {
+                const auto row = source.subspan(static_cast<size_t>(ty + y) * width + tx, w);
+                srgbToLinear(row, std::span(buffer).subspan(static_cast<size_t>(y) * TILE, w), options.srgb, false);
+            }
+
+            for (size_t level = 1; level <= tiled; ++level) {
+                const auto ox = tx >> level;
+                const auto oy = ty >> level;
+                if (ox >= sizes[level].width || oy >= sizes[level].height) {
+                    break;
+                }
+                const auto nw = std::min((TILE >> level), sizes[level].width - ox);
+                const auto nh = std::min((TILE >> level), sizes[level].height - oy);
+
+                /// in place: destination row y only reads source rows 2y and 2y+1, which are never behind it
+                for (glm::u32 y = 0; y < nh; ++y) {
+                    boxRow(buffer.data(), w, h, buffer.data() + static_cast<size_t>(y) * TILE, nw, y, TILE);
+                }
+                w = nw;
+                h = nh;
+
+                auto pixels = levels[level].pixels();
+                for (glm::u32 y = 0; y < h; ++y) {
+                    const auto row = std::span<const glm::vec4>(buffer).subspan(static_cast<size_t>(y) * TILE, w);
+                    linearToSrgb(row, pixels.subspan(static_cast<size_t>(oy + y) * sizes[level].width + ox, w), options.srgb);
+                }
+            }
+        });
+
+        for (size_t i = tiled + 1; i < count; ++i) {
+            levels[i] = downsample(levels[i - 1], {ResampleFilter::Box, options.srgb, false});
+        }
+        return levels;
+    }
+
+private:
+    static ImageInfo nextLevel(const ImageInfo& info) {
+        return {std::max(1u, info.width / 2), std::max(1u, info.height / 2)};
+    }
+
+    static void premultiplyBase(ImageData& image, const MipChainOptions& options) {
+        if (!options.srgb) {
+            premultiplyAlpha(image);
+            return;
+        }
+        const auto [width, height] = image.info();
+        std::vector<glm::vec4> linear(static_cast<size_t>(width) * height);
+        decodeRows(image, linear, 0, height, options);
+        encodeRows(linear, image, 0, height, {options.filter, options.srgb, false});
+    }
+
+    static void decodeRows(const ImageData& src, std::span<glm::vec4> dst, glm::u32 y0, glm::u32 y1, const MipChainOptions& options) {
+        const auto width = src.info().width;
+        parallelFor(y1 - y0, [&](size_t i) {
+            const auto offset = (y0 + i) * width;
+            srgbToLinear(src.pixels().subspan(offset, width), dst.subspan(offset, width), options.srgb, options.premultiply);
+        });
+    }
+
+    static void encodeRows(std::span<const glm::vec4> src, ImageData& dst, glm::u32 y0, glm::u32 y1, const MipChainOptions& options) {
+        const auto width = dst.info().width;
+        auto pixels = dst.pixels();
+        parallelFor(y1 - y0, [&](size_t i) {
+            const auto offset = (y0 + i) * width;
+            linearToSrgb(src.subspan(offset, width), pixels.subspan(offset, width), options.srgb);
+        });
+    }
+
+    // One destination row of a 2x2 box reduction. `stride` is the row pitch of both buffers.
+    static void boxRow(const glm::vec4* src, glm::u32 src_width, glm::u32 src_height, glm::vec4* dst, glm::u32 dst_width, glm::u32 y, glm::u32 stride = 0) {
+        if (stride == 0) {
+            stride = src_width;
+        }
+        const auto y0 = std::min(y * 2, src_height - 1);
+        const auto y1 = std::min(y * 2 + 1, src_height - 1);
+        const auto row0 = reinterpret_cast<const float*>(src + static_cast<size_t>(y0) * stride);
+        const auto row1 = reinterpret_cast<const float*>(src + static_cast<size_t>(y1) * stride);
+        const auto quarter = detail::Texel::splat(0.25f);
+
+        for (glm::u32 x = 0; x < dst_width; ++x) {
+            const auto x0 = std::min(x * 2, src_width - 1) * 4;
+            const auto x1 = std::min(x * 2 + 1, src_width - 1) * 4;
+            const auto sum = detail::Texel::load(row0 + x0) + detail::Texel::load(row0 + x1) + detail::Texel::load(row1 + x0) + detail::Texel::load(row1 + x1);
+            (sum * quarter).store(reinterpret_cast<float*>(dst + x));
+        }
+    }
+
+    static double besselI0(double x) {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; ++k) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Taps for an exact 2x decimation: destination x sits between source 2x and 2x+1,
+    // so tap i reads source 2x - 5 + i at distance (i - 5.5).
+    static std::array<float, 12> taps(ResampleFilter filter) {
+        static constexpr double RADIUS = 3.0;
+        static constexpr double KAISER_ALPHA = 4.0;
+
+        const auto sinc = [](double x) {
+            return x == 0.0 ? 1.0 : std::sin(std::numbers::pi * x) / (std::numbers::pi * x);
+        };
+
+        std::array<float, 12> weights{};
+        double total = 0.0;
+        for (size_t i = 0; i < weights.size(); ++i) {
+            const auto t = (static_cast<double>(i) - 5.5) / 2.0;
+            double window = 0.0;
+            if (filter == ResampleFilter::Lanczos3) {
+                window = sinc(t / RADIUS);
+            } else {
+                const auto r = t / RADIUS;
+                window = std::abs(r) < 1.0 ? besselI0(KAISER_ALPHA * std::sqrt(1.0 - r * r)) / besselI0(KAISER_ALPHA) : 0.0;
+            }
+            weights[i] = static_cast<float>(sinc(t) * window);
+            total += weights[i];
+        }
+        for (auto& w : weights) {
+            w = static_cast<float>(w / total);
+        }
+        return weights;
+    }
+
+    static void resample(std::span<const glm::vec4> src, ImageInfo src_size, std::span<glm::vec4> dst, ImageInfo dst_size, ResampleFilter filter) {
+        const auto weights = taps(filter);
+        std::vector<glm::vec4> horizontal(static_cast<size_t>(dst_size.width) * src_size.height);
+
+        const auto tap = [](glm::u32 center, size_t i, glm::u32 size) {
+            const auto s = static_cast<int64_t>(center) * 2 - 5 + static_cast<int64_t>(i);
+            return static_cast<size_t>(std::clamp<int64_t>(s, 0, static_cast<int64_t>(size) - 1));
+        };
+
+        parallelFor(src_size.height, [&](size_t y) {
+            const auto row = reinterpret_cast<const float*>(src.data() + y * src_size.width);
+            for (glm::u32 x = 0; x < dst_size.width; ++x) {
+                auto sum = detail::Texel::zero();
+                for (size_t i = 0; i < weights.size(); ++i) {
+                    sum = sum + detail::Texel::load(row + tap(x, i, src_size.width) * 4) * detail::Texel::splat(weights[i]);
+                }
+                sum.store(reinterpret_cast<float*>(horizontal.data() + y * dst_size.width + x));
+            }
+        });
+
+        parallelFor(dst_size.height, [&](size_t y) {
+            std::array<const float*, 12> rows{};
+            for (size_t i = 0; i < rows.size(); ++i) {
+                rows[i] = reinterpret_cast<const float*>(horizontal.data() + tap(static_cast<glm::u32>(y), i, src_size.height) * dst_size.width);
+            }
+            for (glm::u32 x = 0; x < dst_size.width; ++x) {
+                auto sum = detail::Texel::zero();
+                for (size_t i = 0; i < rows.size(); ++i) {
+                    sum = sum + detail::Texel::load(rows[i] + x * 4) * detail::Texel::splat(weights[i]);
+                }
+                clamp01(sum).store(reinterpret_cast<float*>(dst.data() + y * dst_size.width + x));
+            }
+        });
+    }
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <RenderContext.hpp>
+
 #include <span>
 
 struct VertexArrayAttrib {
@@ -24,8 +26,9 @@ struct Mesh {
     size_t index_count = 0;
     size_t vertex_count = 0;
     GLenum usage;
+    GpuMemoryRegistry* memory;
 
-    Mesh(std::span<const VertexArrayAttrib> attributes, std::span<const VertexArrayBinding> bindings, GLsizei size, GLenum usage) : usage(usage) {
+    Mesh(RenderContext& renderContext, std::span<const VertexArrayAttrib> attributes, std::span<const VertexArrayBinding> bindings, GLsizei size, GLenum usage) : usage(usage), memory(&renderContext.memory) {
         glCreateVertexArrays(1, &vao);
         glCreateBuffers(1, &vbo);
         glCreateBuffers(1, &ibo);
@@ -44,6 +47,8 @@ struct Mesh {
     }
 
     ~Mesh() {
+        memory->release(GpuResource::Buffer, ibo);
+        memory->release(GpuResource::Buffer, vbo);
         glDeleteBuffers(1, &ibo);
         glDeleteBuffers(1, &vbo);
         glDeleteVertexArrays(1, &vao);
@@ -55,6 +60,7 @@ struct Mesh {
         if (vertices.size_bytes() > vbo_size) {
             vbo_size = vertices.size_bytes();
             glNamedBufferData(vbo, vertices.size_bytes(), vertices.data(), usage);
+            memory->track(GpuResource::Buffer, vbo, GpuMemoryCategory::Mesh, static_cast<size_t>(vbo_size));
         } else {
             glNamedBufferSubData(vbo, 0, vertices.size_bytes(), vertices.data());
         }
@@ -66,6 +72,7 @@ struct Mesh {
         if (indices.size_bytes() > ibo_size) {
             ibo_size = indices.size_bytes();
             glNamedBufferData(ibo, indices.size_bytes(), indices.data(), usage);
+            memory->track(GpuResource::Buffer, ibo, GpuMemoryCategory::Mesh, static_cast<size_t>(ibo_size));
         } else {
             glNamedBufferSubData(ibo, 0, indices.size_bytes(), indices.data());
         }
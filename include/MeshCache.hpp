@@ -0,0 +1,422 @@
+#pragma once
+
+#include <Mesh.hpp>
+#include <utils/hash.hpp>
+
+#include <fmt/format.h>
+#include <condition_variable>
+#include <unordered_map>
+#include <filesystem>
+#include <algorithm>
+#include <optional>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <deque>
+#include <span>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read-only mapping of a whole file; empty when it could not be opened or has no bytes.
+struct MappedFile {
+    MappedFile() = default;
+
+    explicit MappedFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+        const auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER size{};
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+            if (const auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+                _data = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                _size = _data != nullptr ? static_cast<size_t>(size.QuadPart) : 0;
+                CloseHandle(mapping); /// the view keeps the mapping alive
+            }
+        }
+        CloseHandle(file);
+#else
+        const auto file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0) {
+            return;
+        }
+        struct stat info{};
+        if (::fstat(file, &info) == 0 && info.st_size > 0) {
+            const auto data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+            if (data != MAP_FAILED) {
+                _data = static_cast<const std::byte*>(data);
+                _size = static_cast<size_t>(info.st_size);
+            }
+        }
+        ::close(file); /// the mapping keeps the file alive
+#endif
+    }
+
+    ~MappedFile() {
+        unmap();
+    }
+
+    MappedFile(MappedFile&& other) noexcept : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)) {}
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            _data = std::exchange(other._data, nullptr);
+            _size = std::exchange(other._size, 0);
+        }
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::span<const std::byte> bytes() const {
+        return {_data, _size};
+    }
+
+    explicit operator bool() const {
+        return _data != nullptr;
+    }
+
+private:
+    void unmap() {
+        if (_data == nullptr) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(_data);
+#else
+        ::munmap(const_cast<std::byte*>(_data), _size);
+#endif
+        _data = nullptr;
+        _size = 0;
+    }
+
+    const std::byte* _data = nullptr;
+    size_t _size = 0;
+};
+
+// Mesh stored by MeshCache, viewed in place in its mapped file. The spans stay valid for as long as
+// this object lives, and go straight to Mesh::SetVertices/SetIndices or MeshHeap::create.
+struct MappedMesh {
+    MappedFile file;
+    std::vector<VertexArrayAttrib> attributes;
+    uint32_t stride = 0;
+    std::span<const std::byte> vertex_bytes;
+    std::span<const uint32_t> indices;
+
+    // Expects the mesh to have been stored with sizeof(Vertex) as its stride.
+    template <typename Vertex>
+    std::span<const Vertex> vertices() const {
+        return {reinterpret_cast<const Vertex*>(vertex_bytes.data()), vertex_bytes.size() / sizeof(Vertex)};
+    }
+};
+
+// Generated geometry on disk, one file per mesh, named by a hash of the caller's content key and the
+// vertex layout. Callers hash whatever the mesh is generated from (voxels, shape parameters, the
+// version of the generator) into the key, so changed input simply misses and is regenerated.
+//
+// store() only lays the entry out in memory; a writer thread puts it on disk, so no file I/O happens
+// on the caller's thread. Stores are dropped while more than MAX_QUEUED bytes wait for the writer.
+// The directory is kept under `max_bytes` by deleting the oldest entries, by modification time.
+//
+// File layout, every section starting on a 16-byte boundary so the mapped vertex data is aligned:
+//   Header, Attribute[attribute_count], vertex blob (vertex_count * stride bytes), uint32_t indices.
+// Nothing is parsed beyond checking the header against the key, layout and file size.
+struct MeshCache {
+    static constexpr size_t MAX_QUEUED = size_t(64) << 20;
+
+    explicit MeshCache(std::filesystem::path directory, size_t max_bytes = size_t(256) << 20) : _directory(std::move(directory)), _max_bytes(max_bytes) {
+        std::error_code ec;
+        std::filesystem::create_directories(_directory, ec);
+        scan();
+        _writer = std::thread([this] { writerLoop(); });
+    }
+
+    // Writes out whatever is still queued.
+    ~MeshCache() {
+        {
+            std::lock_guard lock{_mutex};
+            _stop = true;
+        }
+        _wake.notify_one();
+        _writer.join();
+    }
+
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+
+    std::optional<MappedMesh> load(uint64_t key, std::span<const VertexArrayAttrib> attributes, uint32_t stride) const {
+        MappedFile file{pathFor(key, attributes, stride)};
+        const auto bytes = file.bytes();
+        if (bytes.size() < sizeof(Header)) {
+            return std::nullopt;
+        }
+
+        const auto& header = *reinterpret_cast<const Header*>(bytes.data());
+        if (header.magic != MAGIC || header.version != VERSION || header.key != key || header.stride != stride || header.attribute_count != attributes.size()) {
+            return std::nullopt;
+        }
+        const auto vertex_size = static_cast<uint64_t>(header.vertex_count) * stride;
+        const auto index_size = static_cast<uint64_t>(header.index_count) * sizeof(uint32_t);
+        const auto layout_end = sizeof(Header) + attributes.size() * sizeof(Attribute);
+        /// written as offset <= size && length <= size - offset so that nothing can overflow
+        const auto inside = [size = static_cast<uint64_t>(bytes.size())](uint64_t offset, uint64_t length) {
+            return offset % ALIGNMENT == 0 && offset <= size && length <= size - offset;
+        };
+        if (header.vertex_offset < layout_end || !inside(header.vertex_offset, vertex_size) || !inside(header.index_offset, index_size)) {
+            return std::nullopt;
+        }
+
+        const auto stored = reinterpret_cast<const Attribute*>(bytes.data() + sizeof(Header));
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            if (stored[i] != Attribute::from(attributes[i])) {
+                return std::nullopt;
+            }
+        }
+
+        MappedMesh mesh{};
+        mesh.attributes.assign(attributes.begin(), attributes.end());
+        mesh.stride = stride;
+        mesh.vertex_bytes = bytes.subspan(header.vertex_offset, vertex_size);
+        mesh.indices = {reinterpret_cast<const uint32_t*>(bytes.data() + header.index_offset), header.index_count};
+        mesh.file = std::move(file); /// moving the mapping leaves its address, and so the spans, unchanged
+        return mesh;
+    }
+
+    // Safe to call from several threads. Returns false when the entry was dropped because the writer
+    // is behind; failures to write it are reported by the writer.
+    bool store(uint64_t key, std::span<const VertexArrayAttrib> attributes, uint32_t stride, std::span<const std::byte> vertices, std::span<const uint32_t> indices) {
+        Header header{};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.key = key;
+        header.stride = stride;
+        header.attribute_count = static_cast<uint32_t>(attributes.size());
+        header.vertex_count = static_cast<uint32_t>(vertices.size() / stride);
+        header.index_count = static_cast<uint32_t>(indices.size());
+        header.vertex_offset = align(sizeof(Header) + attributes.size() * sizeof(Attribute));
+        header.index_offset = align(header.vertex_offset + vertices.size());
+
+        const auto size = header.index_offset + indices.size_bytes();
+        {
+            std::lock_guard lock{_mutex};
+            if (_queued_bytes + size > MAX_QUEUED) {
+                return false;
+            }
+            _queued_bytes += size;
+        }
+
+        std::vector<char> buffer(size, 0);
+        std::memcpy(buffer.data(), &header, sizeof(header));
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            const auto attribute = Attribute::from(attributes[i]);
+            std::memcpy(buffer.data() + sizeof(Header) + i * sizeof(Attribute), &attribute, sizeof(attribute));
+        }
+        std::memcpy(buffer.data() + header.vertex_offset, vertices.data(), vertices.size());
+        std::memcpy(buffer.data() + header.index_offset, indices.data(), indices.size_bytes());
+
+        {
+            std::lock_guard lock{_mutex};
+            _pending.push_back(Pending{pathFor(key, attributes, stride), std::move(buffer)});
+        }
+        _wake.notify_one();
+        return true;
+    }
+
+    template <typename Vertex>
+    bool store(uint64_t key, std::span<const VertexArrayAttrib> attributes, std::span<const Vertex> vertices, std::span<const uint32_t> indices) {
+        return store(key, attributes, sizeof(Vertex), std::as_bytes(vertices), indices);
+    }
+
+    // Entries on disk, as of the writer's last write.
+    size_t bytes() const {
+        return _bytes.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint32_t MAGIC = 0x3148534d; /// "MSH1"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t ALIGNMENT = 16;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t stride;
+        uint32_t attribute_count;
+        uint32_t vertex_count;
+        uint32_t index_count;
+        uint64_t vertex_offset;
+        uint64_t index_offset;
+    };
+
+    /// VertexArrayAttrib with fixed-width fields and no padding
+    struct Attribute {
+        uint32_t index;
+        int32_t size;
+        uint32_t type;
+        uint32_t normalized;
+        uint32_t offset;
+
+        static Attribute from(const VertexArrayAttrib& attrib) {
+            return {attrib.index, attrib.size, attrib.type, attrib.normalized, attrib.offset};
+        }
+
+        friend bool operator==(const Attribute&, const Attribute&) = default;
+    };
+
+    struct Pending {
+        std::filesystem::path path;
+        std::vector<char> buffer;
+    };
+
+    struct Entry {
+        std::filesystem::path path;
+        size_t size;
+    };
+
+    /// existing entries, oldest first; leftovers of interrupted writes are deleted
+    void scan() {
+        std::vector<std::pair<std::filesystem::file_time_type, Entry>> found{};
+        std::error_code ec;
+        for (const auto& item : std::filesystem::directory_iterator(_directory, ec)) {
+            const auto& path = item.path();
+            if (path.extension() == ".tmp") {
+                std::filesystem::remove(path, ec);
+            } else if (path.extension() == ".mesh") {
+                found.emplace_back(item.last_write_time(ec), Entry{path, static_cast<size_t>(item.file_size(ec))});
+            }
+        }
+        std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+        for (auto& [time, entry] : found) {
+            add(std::move(entry));
+        }
+        evict();
+    }
+
+    void writerLoop() {
+        while (true) {
+            Pending pending{};
+            {
+                std::unique_lock lock{_mutex};
+                _wake.wait(lock, [this] { return _stop || !_pending.empty(); });
+                if (_pending.empty()) {
+                    return;
+                }
+                pending = std::move(_pending.front());
+                _pending.pop_front();
+            }
+
+            const auto size = pending.buffer.size();
+            if (write(pending.path, pending.buffer)) {
+                add(Entry{std::move(pending.path), size});
+                evict();
+            }
+
+            std::lock_guard lock{_mutex};
+            _queued_bytes -= size;
+        }
+    }
+
+    /// to a temporary name first, so that a crash never leaves a truncated entry behind
+    static bool write(const std::filesystem::path& path, const std::vector<char>& buffer) {
+        auto temporary = path;
+        temporary += ".tmp";
+
+        std::ofstream file{temporary, std::ios::binary | std::ios::trunc};
+        if (file) {
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            file.close();
+        }
+
+        std::error_code ec;
+        if (file) {
+            std::filesystem::rename(temporary, path, ec);
+            if (!ec) {
+                return true;
+            }
+        }
+        fmt::print("Failed to write mesh cache entry '{}'\n", path.string());
+        std::filesystem::remove(temporary, ec);
+        return false;
+    }
+
+    /// writer thread only, like evict()
+    void add(Entry entry) {
+        const auto [it, inserted] = _sizes.try_emplace(entry.path.string(), entry.size);
+        if (inserted) {
+            _order.push_back(std::move(entry.path));
+            _total += entry.size;
+        } else {
+            _total = _total - it->second + entry.size; /// rewritten in place, keeps its age
+            it->second = entry.size;
+        }
+        _bytes.store(_total, std::memory_order_relaxed);
+    }
+
+    void evict() {
+        std::error_code ec;
+        while (_total > _max_bytes && !_order.empty()) {
+            const auto path = std::move(_order.front());
+            _order.pop_front();
+            const auto it = _sizes.find(path.string());
+            _total -= it->second;
+            _sizes.erase(it);
+            std::filesystem::remove(path, ec);
+        }
+        _bytes.store(_total, std::memory_order_relaxed);
+    }
+
+    static uint64_t align(uint64_t offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    std::filesystem::path pathFor(uint64_t key, std::span<const VertexArrayAttrib> attributes, uint32_t stride) const {
+        auto layout = Hash64::compute(&stride, sizeof(stride), key);
+        for (const auto& attrib : attributes) {
+            const auto attribute = Attribute::from(attrib);
+            layout = Hash64::compute(&attribute, sizeof(attribute), layout);
+        }
+        return _directory / fmt::format("{:016x}.mesh", layout);
+    }
+
+    std::filesystem::path _directory;
+    size_t _max_bytes;
+
+    std::mutex _mutex{};
+    std::condition_variable _wake{};
+    std::deque<Pending> _pending{};
+    size_t _queued_bytes = 0;
+    bool _stop = false;
+
+    std::deque<std::filesystem::path> _order{}; /// entries on disk, oldest first
+    std::unordered_map<std::string, size_t> _sizes{};
+    size_t _total = 0;
+    std::atomic<size_t> _bytes{0};
+
+    std::thread _writer{};
+};
@@ -0,0 +1,416 @@
+#pragma once
+
+#include <RenderContext.hpp>
+#include <Mesh.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+#include <cstdint>
+#include <vector>
+#include <span>
+#include <map>
+
+// Best-fit free list over [0, capacity) in abstract units; neighbouring free ranges are merged on free.
+struct RangeAllocator {
+    explicit RangeAllocator(uint32_t capacity = 0) {
+        grow(capacity);
+    }
+
+    std::optional<uint32_t> allocate(uint32_t size) {
+        if (size == 0) {
+            return _capacity;
+        }
+
+        auto best = _free.end();
+        for (auto it = _free.begin(); it != _free.end(); ++it) {
+            if (it->second >= size && (best == _free.end() || it->second < best->second)) {
+                best = it;
+                if (it->second == size) {
+                    break;
+                }
+            }
+        }
+        if (best == _free.end()) {
+            return std::nullopt;
+        }
+
+        const auto [offset, available] = *best;
+        _free.erase(best);
+        if (available > size) {
+            _free.emplace(offset + size, available - size);
+        }
+        _used += size;
+        return offset;
+    }
+
+    void free(uint32_t offset, uint32_t size) {
+        if (size == 0) {
+            return;
+        }
+        _used -= size;
+
+        auto next = _free.lower_bound(offset);
+        if (next != _free.end() && offset + size == next->first) {
+            size += next->second;
+            next = _free.erase(next);
+        }
+        if (next != _free.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset) {
+                prev->second += size;
+                return;
+            }
+        }
+        _free.emplace(offset, size);
+    }
+
+    // Extends the range; the new space is merged with a free block at the old end.
+    void grow(uint32_t capacity) {
+        if (capacity > _capacity) {
+            const auto previous = _capacity;
+            _capacity = capacity;
+            _used += capacity - previous;
+            free(previous, capacity - previous);
+        }
+    }
+
+    // Cuts the range down to `capacity`, which must not be below used(); for after a compaction.
+    void shrink(uint32_t capacity) {
+        _capacity = capacity;
+        reset(_used);
+    }
+
+    // Marks [0, used) as allocated and the rest as free, for after a compaction.
+    void reset(uint32_t used) {
+        _free.clear();
+        _used = used;
+        if (used < _capacity) {
+            _free.emplace(used, _capacity - used);
+        }
+    }
+
+    uint32_t capacity() const {
+        return _capacity;
+    }
+
+    uint32_t used() const {
+        return _used;
+    }
+
+    uint32_t largestFree() const {
+        uint32_t largest = 0;
+        for (const auto& [offset, size] : _free) {
+            largest = std::max(largest, size);
+        }
+        return largest;
+    }
+
+private:
+    std::map<uint32_t, uint32_t> _free{}; /// offset -> size
+    uint32_t _capacity = 0;
+    uint32_t _used = 0;
+};
+
+struct MeshRange {
+    GLint base_vertex = 0;
+    GLuint vertex_count = 0;
+    GLuint first_index = 0;
+    GLuint index_count = 0;
+};
+
+struct MeshHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool valid() const {
+        return index != UINT32_MAX;
+    }
+};
+
+// Every mesh of one vertex layout lives in a single immutable vertex buffer and a single 32-bit index
+// buffer, so they share one VAO and draw with glDrawElementsBaseVertex. Ranges are sub-allocated from
+// a free list. When one doesn't fit the heap first compacts, if that would free enough contiguous
+// space, and otherwise doubles the buffers, copying on the GPU. trim() halves them again once they
+// are mostly free. Handles stay valid across all three.
+struct MeshHeap {
+    MeshHeap(
+        RenderContext& renderContext,
+        std::span<const VertexArrayAttrib> attributes,
+        std::span<const VertexArrayBinding> bindings,
+        GLsizei stride,
+        uint32_t vertex_capacity = 1 << 16,
+        uint32_t index_capacity = 1 << 18
+    ) : _memory(renderContext.memory), _stride(stride), _vertices(vertex_capacity), _indices(index_capacity), _minimum_vertices(vertex_capacity), _minimum_indices(index_capacity) {
+        glCreateVertexArrays(1, &_vao);
+        for (const auto& attrib : attributes) {
+            glEnableVertexArrayAttrib(_vao, attrib.index);
+            glVertexArrayAttribFormat(_vao, attrib.index, attrib.size, attrib.type, attrib.normalized, attrib.offset);
+        }
+        for (const auto& binding : bindings) {
+            glVertexArrayAttribBinding(_vao, binding.index, binding.binding);
+        }
+
+        _vbo = createBuffer(static_cast<GLsizeiptr>(vertex_capacity) * _stride);
+        _ibo = createBuffer(static_cast<GLsizeiptr>(index_capacity) * sizeof(uint32_t));
+        glVertexArrayVertexBuffer(_vao, 0, _vbo, 0, _stride);
+        glVertexArrayElementBuffer(_vao, _ibo);
+    }
+
+    ~MeshHeap() {
+        destroyBuffer(_vbo);
+        destroyBuffer(_ibo);
+        glDeleteVertexArrays(1, &_vao);
+    }
+
+    MeshHeap(const MeshHeap&) = delete;
+    MeshHeap& operator=(const MeshHeap&) = delete;
+
+    // Indices are relative to the mesh's own vertices.
+    template <typename Vertex>
+    MeshHandle create(std::span<const Vertex> vertices, std::span<const uint32_t> indices) {
+        const auto handle = reserve(static_cast<uint32_t>(vertices.size_bytes() / static_cast<size_t>(_stride)), static_cast<uint32_t>(indices.size()));
+        const auto& range = _entries[handle.index].range;
+        glNamedBufferSubData(_vbo, static_cast<GLintptr>(range.base_vertex) * _stride, static_cast<GLsizeiptr>(vertices.size_bytes()), vertices.data());
+        glNamedBufferSubData(_ibo, static_cast<GLintptr>(range.first_index) * sizeof(uint32_t), static_cast<GLsizeiptr>(indices.size_bytes()), indices.data());
+        return handle;
+    }
+
+    // Copies on the GPU from `source`, which holds `vertex_count` vertices from byte 0 and
+    // `index_count` indices from byte `index_offset`, e.g. a buffer filled by AsyncUploader.
+    MeshHandle create(GLuint source, uint32_t vertex_count, GLintptr index_offset, uint32_t index_count) {
+        const auto handle = reserve(vertex_count, index_count);
+        const auto& range = _entries[handle.index].range;
+        glCopyNamedBufferSubData(source, _vbo, 0, static_cast<GLintptr>(range.base_vertex) * _stride, static_cast<GLsizeiptr>(vertex_count) * _stride);
+        glCopyNamedBufferSubData(source, _ibo, index_offset, static_cast<GLintptr>(range.first_index) * sizeof(uint32_t), static_cast<GLsizeiptr>(index_count) * sizeof(uint32_t));
+        return handle;
+    }
+
+    void destroy(MeshHandle handle) {
+        if (!contains(handle)) {
+            return;
+        }
+
+        auto& entry = _entries[handle.index];
+        _vertices.free(static_cast<uint32_t>(entry.range.base_vertex), entry.range.vertex_count);
+        _indices.free(entry.range.first_index, entry.range.index_count);
+        entry.alive = false;
+        entry.generation += 1;
+        _unused.push_back(handle.index);
+    }
+
+    bool contains(MeshHandle handle) const {
+        return handle.index < _entries.size() && _entries[handle.index].alive && _entries[handle.index].generation == handle.generation;
+    }
+
+    const MeshRange& range(MeshHandle handle) const {
+        return _entries[handle.index].range;
+    }
+
+    void bind() const {
+        glBindVertexArray(_vao);
+    }
+
+    // Expects bind() to have been called.
+    void draw(MeshHandle handle, GLenum mode = GL_TRIANGLES) const {
+        const auto& r = range(handle);
+        const auto offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(r.first_index) * sizeof(uint32_t));
+        glDrawElementsBaseVertex(mode, static_cast<GLsizei>(r.index_count), GL_UNSIGNED_INT, offset, r.base_vertex);
+    }
+
+    // Moves every live mesh to the front of the buffers, leaving one free range at the end of each.
+    void defragment() {
+        compact(_vertices, _vbo, _stride, [](MeshRange& r) -> std::pair<uint32_t, uint32_t> {
+            return {static_cast<uint32_t>(r.base_vertex), r.vertex_count};
+        }, [](MeshRange& r, uint32_t offset) {
+            r.base_vertex = static_cast<GLint>(offset);
+        });
+        compact(_indices, _ibo, sizeof(uint32_t), [](MeshRange& r) -> std::pair<uint32_t, uint32_t> {
+            return {r.first_index, r.index_count};
+        }, [](MeshRange& r, uint32_t offset) {
+            r.first_index = offset;
+        });
+    }
+
+    // Compacts and halves a buffer while at most a quarter of it is used, down to its initial capacity,
+    // so that destroyed meshes give their memory back. Returns whether anything shrank.
+    bool trim() {
+        const auto vertex_capacity = trimmed(_vertices, _minimum_vertices);
+        const auto index_capacity = trimmed(_indices, _minimum_indices);
+        if (vertex_capacity == _vertices.capacity() && index_capacity == _indices.capacity()) {
+            return false;
+        }
+
+        defragment();
+        shrink(_vertices, _vbo, _stride, vertex_capacity);
+        shrink(_indices, _ibo, sizeof(uint32_t), index_capacity);
+        return true;
+    }
+
+    GLuint vao() const {
+        return _vao;
+    }
+
+    GLuint vertexBuffer() const {
+        return _vbo;
+    }
+
+    GLuint indexBuffer() const {
+        return _ibo;
+    }
+
+    const RangeAllocator& vertices() const {
+        return _vertices;
+    }
+
+    const RangeAllocator& indices() const {
+        return _indices;
+    }
+
+private:
+    struct Entry {
+        MeshRange range{};
+        uint32_t generation = 0;
+        bool alive = false;
+    };
+
+    MeshHandle reserve(uint32_t vertex_count, uint32_t index_count) {
+        MeshHandle handle{};
+        if (!_unused.empty()) {
+            handle.index = _unused.back();
+            _unused.pop_back();
+        } else {
+            handle.index = static_cast<uint32_t>(_entries.size());
+            _entries.emplace_back();
+        }
+
+        /// the entry is live before its ranges are allocated, so a compaction triggered by the second allocation moves the first
+        auto& entry = _entries[handle.index];
+        entry.range = MeshRange{};
+        entry.alive = true;
+        handle.generation = entry.generation;
+
+        entry.range.base_vertex = static_cast<GLint>(allocate(_vertices, vertex_count, _vbo, _stride));
+        entry.range.vertex_count = vertex_count;
+        entry.range.first_index = allocate(_indices, index_count, _ibo, sizeof(uint32_t));
+        entry.range.index_count = index_count;
+        return handle;
+    }
+
+    uint32_t allocate(RangeAllocator& allocator, uint32_t count, GLuint& buffer, GLsizeiptr unit) {
+        if (const auto offset = allocator.allocate(count)) {
+            return *offset;
+        }
+
+        /// compaction helps only if the free space is there, just scattered
+        if (allocator.capacity() - allocator.used() >= count) {
+            defragment();
+            if (const auto offset = allocator.allocate(count)) {
+                return *offset;
+            }
+        }
+
+        auto capacity = std::max<uint32_t>(allocator.capacity(), 1);
+        while (capacity - allocator.used() < count) {
+            capacity *= 2;
+        }
+        resize(buffer, static_cast<GLsizeiptr>(allocator.capacity()) * unit, static_cast<GLsizeiptr>(capacity) * unit);
+        allocator.grow(capacity);
+
+        /// after a compaction the free space is at the end, so growing makes it contiguous
+        if (const auto offset = allocator.allocate(count)) {
+            return *offset;
+        }
+        defragment();
+        return *allocator.allocate(count);
+    }
+
+    template <typename Get, typename Set>
+    void compact(RangeAllocator& allocator, GLuint& buffer, GLsizeiptr unit, Get get, Set set) {
+        std::vector<Entry*> live{};
+        for (auto& entry : _entries) {
+            if (entry.alive) {
+                live.push_back(&entry);
+            }
+        }
+        std::sort(live.begin(), live.end(), [&](Entry* a, Entry* b) {
+            return get(a->range).first < get(b->range).first;
+        });
+
+        const auto size = static_cast<GLsizeiptr>(allocator.capacity()) * unit;
+        const auto target = createBuffer(size);
+
+        uint32_t cursor = 0;
+        for (auto entry : live) {
+            const auto [offset, count] = get(entry->range);
+            if (count != 0) {
+                glCopyNamedBufferSubData(buffer, target, static_cast<GLintptr>(offset) * unit, static_cast<GLintptr>(cursor) * unit, static_cast<GLsizeiptr>(count) * unit);
+            }
+            set(entry->range, cursor);
+            cursor += count;
+        }
+
+        replace(buffer, target);
+        allocator.reset(cursor);
+    }
+
+    static uint32_t trimmed(const RangeAllocator& allocator, uint32_t minimum) {
+        auto capacity = allocator.capacity();
+        while (capacity / 2 >= minimum && allocator.used() <= capacity / 4) {
+            capacity /= 2;
+        }
+        return capacity;
+    }
+
+    /// expects a compacted allocator, whose live ranges all lie below used()
+    void shrink(RangeAllocator& allocator, GLuint& buffer, GLsizeiptr unit, uint32_t capacity) {
+        if (capacity == allocator.capacity()) {
+            return;
+        }
+        resize(buffer, static_cast<GLsizeiptr>(allocator.used()) * unit, static_cast<GLsizeiptr>(capacity) * unit);
+        allocator.shrink(capacity);
+    }
+
+    void resize(GLuint& buffer, GLsizeiptr size, GLsizeiptr new_size) {
+        const auto target = createBuffer(new_size);
+        glCopyNamedBufferSubData(buffer, target, 0, 0, size);
+        replace(buffer, target);
+    }
+
+    void replace(GLuint& buffer, GLuint target) {
+        destroyBuffer(buffer);
+        buffer = target;
+        if (&buffer == &_vbo) {
+            glVertexArrayVertexBuffer(_vao, 0, _vbo, 0, _stride);
+        } else {
+            glVertexArrayElementBuffer(_vao, _ibo);
+        }
+    }
+
+    GLuint createBuffer(GLsizeiptr size) {
+        GLuint buffer = GL_NONE;
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        _memory.track(GpuResource::Buffer, buffer, GpuMemoryCategory::Mesh, static_cast<size_t>(size));
+        return buffer;
+    }
+
+    void destroyBuffer(GLuint buffer) {
+        _memory.release(GpuResource::Buffer, buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    GpuMemoryRegistry& _memory;
+    GLsizei _stride;
+    GLuint _vao = GL_NONE;
+    GLuint _vbo = GL_NONE;
+    GLuint _ibo = GL_NONE;
+
+    RangeAllocator _vertices;
+    RangeAllocator _indices;
+    uint32_t _minimum_vertices;
+    uint32_t _minimum_indices;
+
+    std::vector<Entry> _entries{};
+    std::vector<uint32_t> _unused{};
+};
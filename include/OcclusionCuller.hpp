@@ -0,0 +1,356 @@
+#pragma once
+
+#include <GL/gl3w.h>
+#include <RenderContext.hpp>
+
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <bit>
+
+struct OcclusionStats {
+    size_t tested = 0;
+    size_t frustum_culled = 0;
+    size_t occlusion_culled = 0;
+    size_t visible = 0;
+};
+
+// Hierarchical-Z occlusion culling. build() reduces the depth attachment of the finished frame into a
+// pyramid where every texel holds the farthest depth of its footprint (the minimum, with reverse-Z),
+// and reads one coarse level back into a persistently mapped buffer without waiting for it. visible()
+// tests bounds against the newest readback that has arrived, projected with the view-projection that
+// depth was rendered with, so the result does not depend on how far the camera moved since. Bounds
+// outside that older view have no depth to test against and count as visible.
+struct OcclusionCuller {
+    static constexpr GLsizei READBACK_WIDTH = 128; /// read back the first pyramid level no wider than this
+
+    explicit OcclusionCuller(RenderContext& renderContext)
+        : _sync(renderContext.frameSync)
+        , _memory(renderContext.memory) {
+        _downsample = renderContext.createComputeShader(DOWNSAMPLE_SHADER);
+        _slots.resize(FrameSync::MAX_DEPTH);
+    }
+
+    ~OcclusionCuller() {
+        for (auto& slot : _slots) {
+            destroySlot(slot);
+        }
+        destroyPyramid();
+        glDeleteProgram(_downsample);
+    }
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // Call once per frame before any visible() with the view-projection of the frame being recorded.
+    void begin(const glm::mat4& view_projection) {
+        _view_projection = view_projection;
+        _stats = std::exchange(_current, OcclusionStats{});
+
+        for (auto& slot : _slots) {
+            if (slot.fence == nullptr) {
+                continue;
+            }
+            const auto status = glClientWaitSync(slot.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                continue;
+            }
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+
+            if (slot.frame >= _depth_frame) {
+                _depth_frame = slot.frame;
+                _depth_size = slot.size;
+                _depth_view_projection = slot.view_projection;
+                _depth.resize(static_cast<size_t>(slot.size.x * slot.size.y));
+                std::memcpy(_depth.data(), slot.pointer, _depth.size() * sizeof(float));
+            }
+        }
+    }
+
+    // Object-space bounds placed by `world`.
+    bool visible(const glm::mat4& world, const glm::vec3& min, const glm::vec3& max) {
+        _current.tested += 1;
+
+        const auto corners = boxCorners(min, max);
+        if (outsideFrustum(_view_projection * world, corners)) {
+            _current.frustum_culled += 1;
+            return false;
+        }
+        if (!_depth.empty() && occluded(_depth_view_projection * world, corners)) {
+            _current.occlusion_culled += 1;
+            return false;
+        }
+        _current.visible += 1;
+        return true;
+    }
+
+    bool visible(const glm::vec3& min, const glm::vec3& max) {
+        return visible(glm::mat4(1.0f), min, max);
+    }
+
+    // Call once the depth attachment of `target` holds the scene rendered with `view_projection`.
+    void build(const RenderTarget& target, const glm::mat4& view_projection) {
+        const auto size = glm::max((target.size + 1) / 2, glm::ivec2(1));
+        if (size != _size) {
+            destroyPyramid();
+            createPyramid(size);
+        }
+
+        glUseProgram(_downsample);
+        auto source = target.depth_attachment;
+        auto source_size = target.size;
+        auto source_level = 0;
+        for (GLsizei level = 0; level < _levels; ++level) {
+            const auto level_size = levelSize(level);
+
+            glBindTextureUnit(0, source);
+            glBindImageTexture(0, _pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            glUniform1i(0, source_level);
+            glUniform2i(1, source_size.x, source_size.y);
+            glDispatchCompute(static_cast<GLuint>((level_size.x + 7) / 8), static_cast<GLuint>((level_size.y + 7) / 8), 1);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+            source = _pyramid;
+            source_size = level_size;
+            source_level = level;
+        }
+        glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glBindTextureUnit(0, 0);
+        glUseProgram(0);
+
+        _pyramid_view_projection = view_projection;
+        readback(view_projection);
+    }
+
+    // Farthest-depth pyramid of the last build(); level 0 is half the render target size.
+    GLuint pyramid() const {
+        return _pyramid;
+    }
+
+    GLsizei levels() const {
+        return _levels;
+    }
+
+    // The view-projection the pyramid's depth was rendered with.
+    const glm::mat4& pyramidViewProjection() const {
+        return _pyramid_view_projection;
+    }
+
+    glm::ivec2 levelSize(GLsizei level) const {
+        return glm::max(glm::ivec2(_size.x >> level, _size.y >> level), glm::ivec2(1));
+    }
+
+    // Counters of the previous frame.
+    const OcclusionStats& stats() const {
+        return _stats;
+    }
+
+private:
+    static constexpr std::string_view DOWNSAMPLE_SHADER = R"(
+        #version 450
+
+        layout (local_size_x = 8, local_size_y = 8) in;
+
+        layout (binding = 0) uniform sampler2D Source;
+        layout (binding = 0, r32f) uniform writeonly image2D Destination;
+        layout (location = 0) uniform int SourceLevel;
+        layout (location = 1) uniform ivec2 SourceSize;
+
+        void main() {
+            const ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+            const ivec2 size = imageSize(Destination);
+            if (any(greaterThanEqual(texel, size))) {
+                return;
+            }
+
+            // level 0 rounds up, so its last texel covers one source texel; later levels round down,
+            // so their last texel also covers the leftover texel of an odd source size
+            const ivec2 extent = ivec2(2) + ivec2(equal(texel, size - 1)) * (SourceSize - size * 2);
+
+            float depth = 1.0;
+            for (int y = 0; y < extent.y; ++y) {
+                for (int x = 0; x < extent.x; ++x) {
+                    depth = min(depth, texelFetch(Source, min(texel * 2 + ivec2(x, y), SourceSize - 1), SourceLevel).r);
+                }
+            }
+            imageStore(Destination, texel, vec4(depth));
+        }
+    )";
+
+    struct Slot {
+        GLuint buffer = GL_NONE;
+        float* pointer = nullptr;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        uint64_t frame = 0;
+        glm::ivec2 size{};
+        glm::mat4 view_projection{1.0f};
+    };
+
+    static std::array<glm::vec4, 8> boxCorners(const glm::vec3& min, const glm::vec3& max) {
+        return {
+            glm::vec4{min.x, min.y, min.z, 1.0f},
+            glm::vec4{max.x, min.y, min.z, 1.0f},
+            glm::vec4{min.x, max.y, min.z, 1.0f},
+            glm::vec4{max.x, max.y, min.z, 1.0f},
+            glm::vec4{min.x, min.y, max.z, 1.0f},
+            glm::vec4{max.x, min.y, max.z, 1.0f},
+            glm::vec4{min.x, max.y, max.z, 1.0f},
+            glm::vec4{max.x, max.y, max.z, 1.0f},
+        };
+    }
+
+    // Clip-space test of every corner against one plane at a time; the near plane is z = w.
+    static bool outsideFrustum(const glm::mat4& mvp, const std::array<glm::vec4, 8>& corners) {
+        std::array<glm::vec4, 8> clip{};
+        for (size_t i = 0; i < corners.size(); ++i) {
+            clip[i] = mvp * corners[i];
+        }
+        const auto all = [&clip](auto&& outside) {
+            return std::all_of(clip.begin(), clip.end(), outside);
+        };
+        return all([](const glm::vec4& p) { return p.x < -p.w; })
+            || all([](const glm::vec4& p) { return p.x > p.w; })
+            || all([](const glm::vec4& p) { return p.y < -p.w; })
+            || all([](const glm::vec4& p) { return p.y > p.w; })
+            || all([](const glm::vec4& p) { return p.z > p.w; });
+    }
+
+    bool occluded(const glm::mat4& mvp, const std::array<glm::vec4, 8>& corners) const {
+        auto lo = glm::vec2(1.0f);
+        auto hi = glm::vec2(-1.0f);
+        auto nearest = 0.0f;
+        for (const auto& corner : corners) {
+            const auto clip = mvp * corner;
+            if (clip.w <= 0.0f || clip.z > clip.w) {
+                /// reaches the camera plane in the depth's view, the footprint is unbounded
+                return false;
+            }
+            const auto ndc = glm::vec3(clip) / clip.w;
+            lo = glm::min(lo, glm::vec2(ndc));
+            hi = glm::max(hi, glm::vec2(ndc));
+            /// window depth for the default [-1, 1] clip range, as written to the depth attachment
+            nearest = std::max(nearest, ndc.z * 0.5f + 0.5f);
+        }
+        if (lo.x < -1.0f || lo.y < -1.0f || hi.x > 1.0f || hi.y > 1.0f) {
+            return false;
+        }
+
+        /// one texel of margin, pyramid texels do not line up exactly with the full resolution grid
+        const auto size = glm::vec2(_depth_size);
+        const auto x0 = std::max(static_cast<int>((lo.x * 0.5f + 0.5f) * size.x) - 1, 0);
+        const auto y0 = std::max(static_cast<int>((lo.y * 0.5f + 0.5f) * size.y) - 1, 0);
+        const auto x1 = std::min(static_cast<int>((hi.x * 0.5f + 0.5f) * size.x) + 1, _depth_size.x - 1);
+        const auto y1 = std::min(static_cast<int>((hi.y * 0.5f + 0.5f) * size.y) + 1, _depth_size.y - 1);
+
+        for (auto y = y0; y <= y1; ++y) {
+            for (auto x = x0; x <= x1; ++x) {
+                if (nearest >= _depth[static_cast<size_t>(y * _depth_size.x + x)]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void readback(const glm::mat4& view_projection) {
+        GLsizei level = 0;
+        while (level + 1 < _levels && levelSize(level).x > READBACK_WIDTH) {
+            level += 1;
+        }
+        const auto size = levelSize(level);
+        const auto bytes = static_cast<size_t>(size.x * size.y) * sizeof(float);
+
+        auto& slot = _slots[_sync.index()];
+        if (slot.fence != nullptr) {
+            /// FrameSync already waited on this frame, so the copy has finished; it is simply superseded
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+        if (slot.capacity < bytes) {
+            destroySlot(slot);
+            createSlot(slot, bytes);
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glGetTextureImage(_pyramid, level, GL_RED, GL_FLOAT, static_cast<GLsizei>(bytes), nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = _sync.frame();
+        slot.size = size;
+        slot.view_projection = view_projection;
+    }
+
+    void createSlot(Slot& slot, size_t bytes) {
+        static constexpr auto flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glCreateBuffers(1, &slot.buffer);
+        glNamedBufferStorage(slot.buffer, static_cast<GLsizeiptr>(bytes), nullptr, flags);
+        slot.pointer = static_cast<float*>(glMapNamedBufferRange(slot.buffer, 0, static_cast<GLsizeiptr>(bytes), flags));
+        slot.capacity = bytes;
+        _memory.track(GpuResource::Buffer, slot.buffer, GpuMemoryCategory::Staging, bytes);
+    }
+
+    void destroySlot(Slot& slot) {
+        if (slot.fence != nullptr) {
+            glDeleteSync(slot.fence);
+        }
+        if (slot.buffer != GL_NONE) {
+            _memory.release(GpuResource::Buffer, slot.buffer);
+            glUnmapNamedBuffer(slot.buffer);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+        slot = Slot{};
+    }
+
+    void createPyramid(const glm::ivec2& size) {
+        _size = size;
+        _levels = static_cast<GLsizei>(std::bit_width(static_cast<uint32_t>(std::max(size.x, size.y))));
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &_pyramid);
+        glTextureStorage2D(_pyramid, _levels, GL_R32F, size.x, size.y);
+        glTextureParameteri(_pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTextureParameteri(_pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureParameteri(_pyramid, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(_pyramid, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        _memory.track(GpuResource::Texture, _pyramid, GpuMemoryCategory::RenderTarget, GpuMemoryRegistry::textureBytes(GL_R32F, size.x, size.y, _levels));
+    }
+
+    void destroyPyramid() {
+        if (_pyramid != GL_NONE) {
+            _memory.release(GpuResource::Texture, _pyramid);
+            glDeleteTextures(1, &_pyramid);
+            _pyramid = GL_NONE;
+        }
+        _size = {};
+        _levels = 0;
+    }
+
+    const FrameSync& _sync;
+    GpuMemoryRegistry& _memory;
+    GLuint _downsample = GL_NONE;
+
+    GLuint _pyramid = GL_NONE;
+    glm::ivec2 _size{};
+    GLsizei _levels = 0;
+    glm::mat4 _pyramid_view_projection{1.0f};
+
+    std::vector<Slot> _slots{};
+
+    /// newest readback that has arrived on the CPU
+    std::vector<float> _depth{};
+    glm::ivec2 _depth_size{};
+    glm::mat4 _depth_view_projection{1.0f};
+    uint64_t _depth_frame = 0;
+
+    glm::mat4 _view_projection{1.0f};
+    OcclusionStats _current{};
+    OcclusionStats _stats{};
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <VoxelChunk.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <array>
+#include <span>
+#include <bit>
+
+// VoxelChunk-shaped storage that keeps the distinct values of a chunk in a small palette and each
+// voxel as an index into it, packed into 64-bit words at the narrowest width (1 to 8 bits) that
+// addresses the whole palette. Indices never straddle words, so a word holds 64 / bits of them. A
+// chunk with one value, empty ones included, stores no words at all. set() appends unseen values and
+// re-packs once the palette outgrows the current width; values that are no longer used stay in the
+// palette until compact(). Meshers should unpack() into a scratch chunk rather than call get().
+struct PalettedChunk {
+    PalettedChunk() = default;
+
+    explicit PalettedChunk(std::span<const uint8_t> voxels) {
+        assign(voxels);
+    }
+
+    // `voxels` is laid out like VoxelChunk::voxels().
+    void assign(std::span<const uint8_t> voxels) {
+        std::array<int16_t, 256> lookup{};
+        lookup.fill(-1);
+        _palette.clear();
+        for (const auto value : voxels) {
+            if (lookup[value] < 0) {
+                lookup[value] = static_cast<int16_t>(_palette.size());
+                _palette.push_back(value);
+            }
+        }
+
+        setBits(bitsFor(_palette.size()));
+        _words.assign(wordCount(), 0);
+        if (_bits != 0) {
+            for (size_t i = 0; i < VoxelChunk::VOLUME; ++i) {
+                _words[i / _per_word] |= static_cast<uint64_t>(lookup[voxels[i]]) << (i % _per_word * _bits);
+            }
+        }
+        _words.shrink_to_fit();
+        _palette.shrink_to_fit();
+    }
+
+    uint8_t get(int x, int y, int z) const {
+        return at(VoxelChunk::index(x, y, z));
+    }
+
+    uint8_t at(size_t index) const {
+        if (_bits == 0) {
+            return _palette[0];
+        }
+        const auto shift = index % _per_word * _bits;
+        return _palette[(_words[index / _per_word] >> shift) & mask()];
+    }
+
+    void set(int x, int y, int z, uint8_t value) {
+        auto entry = static_cast<uint64_t>(std::find(_palette.begin(), _palette.end(), value) - _palette.begin());
+        if (entry == _palette.size()) {
+            _palette.push_back(value);
+            if (_palette.size() > (size_t(1) << _bits)) {
+                repack(bitsFor(_palette.size()));
+            }
+        }
+        if (_bits == 0) {
+            return;
+        }
+
+        const auto index = VoxelChunk::index(x, y, z);
+        const auto shift = index % _per_word * _bits;
+        auto& word = _words[index / _per_word];
+        word = (word & ~(mask() << shift)) | (entry << shift);
+    }
+
+    // Decodes every voxel into `out`, VoxelChunk::VOLUME values, a word at a time.
+    void unpack(std::span<uint8_t> out) const {
+        switch (_bits) {
+            case 0: std::fill(out.begin(), out.end(), _palette[0]); break;
+            case 1: unpackWords<1>(out); break;
+            case 2: unpackWords<2>(out); break;
+            case 3: unpackWords<3>(out); break;
+            case 4: unpackWords<4>(out); break;
+            case 5: unpackWords<5>(out); break;
+            case 6: unpackWords<6>(out); break;
+            case 7: unpackWords<7>(out); break;
+            default: unpackWords<8>(out); break;
+        }
+    }
+
+    void unpack(VoxelChunk& chunk) const {
+        unpack(chunk.voxels());
+    }
+
+    // Drops palette entries that are no longer used and packs at the narrowest width again.
+    void compact() {
+        std::vector<uint8_t> voxels(VoxelChunk::VOLUME);
+        unpack(voxels);
+        assign(voxels);
+    }
+
+    bool uniform() const {
+        return _bits == 0;
+    }
+
+    bool empty() const {
+        return _bits == 0 && _palette[0] == 0;
+    }
+
+    int bits() const {
+        return _bits;
+    }
+
+    std::span<const uint8_t> palette() const {
+        return _palette;
+    }
+
+    // Heap and inline storage, for comparing against VoxelChunk::VOLUME bytes of a flat chunk.
+    size_t bytes() const {
+        return sizeof(*this) + _words.capacity() * sizeof(uint64_t) + _palette.capacity();
+    }
+
+private:
+    static int bitsFor(size_t entries) {
+        return entries <= 1 ? 0 : static_cast<int>(std::bit_width(entries - 1));
+    }
+
+    uint64_t mask() const {
+        return (uint64_t(1) << _bits) - 1;
+    }
+
+    size_t wordCount() const {
+        return _bits == 0 ? 0 : (VoxelChunk::VOLUME + _per_word - 1) / _per_word;
+    }
+
+    void setBits(int bits) {
+        _bits = bits;
+        _per_word = bits == 0 ? 0 : 64 / static_cast<uint32_t>(bits);
+    }
+
+    void repack(int bits) {
+        const auto old_words = std::move(_words);
+        const auto old_bits = _bits;
+        const auto old_per_word = _per_word;
+        const auto old_mask = mask();
+
+        setBits(bits);
+        _words.assign(wordCount(), 0);
+        if (old_bits == 0) {
+            return; /// every index was 0, which the zeroed words already say
+        }
+        for (size_t i = 0; i < VoxelChunk::VOLUME; ++i) {
+            const auto entry = (old_words[i / old_per_word] >> (i % old_per_word * old_bits)) & old_mask;
+            _words[i / _per_word] |= entry << (i % _per_word * _bits);
+        }
+    }
+
+    template <int Bits>
+    void unpackWords(std::span<uint8_t> out) const {
+        constexpr auto PER_WORD = 64 / Bits;
+        constexpr auto MASK = (uint64_t(1) << Bits) - 1;
+
+        size_t i = 0;
+        for (const auto word : _words) {
+            const auto count = std::min<size_t>(PER_WORD, VoxelChunk::VOLUME - i);
+            for (size_t j = 0; j < count; ++j) {
+                out[i + j] = _palette[(word >> (j * Bits)) & MASK];
+            }
+            i += count;
+        }
+    }
+
+    std::vector<uint64_t> _words{};
+    std::vector<uint8_t> _palette{0}; /// value of each index; default constructed chunks are air
+    int _bits = 0;
+    uint32_t _per_word = 0;
+};
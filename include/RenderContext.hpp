@@ -3,21 +3,29 @@
 #include <fmt/format.h>
 #include <string_view>
 #include <GL/gl3w.h>
+#include <GpuMemory.hpp>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
 #include <string>
+#include <vector>
 
 struct RenderTarget {
     glm::ivec2 size;
     GLuint framebuffer;
     GLuint color_attachment;
     GLuint depth_attachment;
+    GpuMemoryRegistry* memory = nullptr;
 
     ~RenderTarget() {
         if (color_attachment != 0) {
+            memory->release(GpuResource::Texture, color_attachment);
             glDeleteTextures(1, &color_attachment);
             color_attachment = 0;
         }
         if (depth_attachment != 0) {
-            glDeleteRenderbuffers(1, &depth_attachment);
+            memory->release(GpuResource::Texture, depth_attachment);
+            glDeleteTextures(1, &depth_attachment);
             depth_attachment = 0;
         }
         if (framebuffer != 0) {
@@ -27,7 +35,109 @@ struct RenderTarget {
     }
 };
 
+// Bounds how far the CPU may run ahead of the GPU. end() fences the work of the current frame in its
+// slot; begin() blocks until the fence of the slot about to be reused has signalled, so anything
+// indexed by index() (mapped buffers, render targets) is never written while the GPU still reads it.
+// A depth of 1 gives the lowest latency, larger depths trade latency for throughput.
+struct FrameSync {
+    static constexpr size_t MIN_DEPTH = 1;
+    static constexpr size_t MAX_DEPTH = 4;
+
+    explicit FrameSync(size_t depth = 2) : _fences(MAX_DEPTH, nullptr), _depth(std::clamp(depth, MIN_DEPTH, MAX_DEPTH)) {}
+
+    ~FrameSync() {
+        for (auto& fence : _fences) {
+            if (fence != nullptr) {
+                glDeleteSync(fence);
+            }
+        }
+    }
+
+    FrameSync(const FrameSync&) = delete;
+    FrameSync& operator=(const FrameSync&) = delete;
+
+    void begin() {
+        const auto start = std::chrono::steady_clock::now();
+        wait(_index);
+        _waitTime = std::chrono::steady_clock::now() - start;
+        _waitTotal += _waitTime;
+    }
+
+    void end() {
+        _fences[_index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        _index = (_index + 1) % _depth;
+        _frame += 1;
+    }
+
+    // Drains every frame in flight before changing the depth; call between frames.
+    void setDepth(size_t depth) {
+        depth = std::clamp(depth, MIN_DEPTH, MAX_DEPTH);
+        if (depth == _depth) {
+            return;
+        }
+        for (size_t i = 0; i < _depth; ++i) {
+            wait(i);
+        }
+        _depth = depth;
+        _index = 0;
+    }
+
+    // Blocks until the GPU has finished the most recently submitted frame.
+    void waitPrevious() {
+        wait((_index + _depth - 1) % _depth);
+    }
+
+    size_t depth() const {
+        return _depth;
+    }
+
+    size_t index() const {
+        return _index;
+    }
+
+    uint64_t frame() const {
+        return _frame;
+    }
+
+    // Time begin() spent blocked on the GPU in the current frame.
+    std::chrono::duration<double, std::milli> waitTime() const {
+        return _waitTime;
+    }
+
+    std::chrono::duration<double, std::milli> waitTotal() const {
+        return _waitTotal;
+    }
+
+private:
+    void wait(size_t slot) {
+        auto& fence = _fences[slot];
+        if (fence == nullptr) {
+            return;
+        }
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (true) {
+            const auto status = glClientWaitSync(fence, flags, 1'000'000'000);
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED) {
+                break;
+            }
+            flags = 0;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    std::vector<GLsync> _fences;
+    size_t _depth;
+    size_t _index = 0;
+    uint64_t _frame = 0;
+    std::chrono::duration<double, std::milli> _waitTime{};
+    std::chrono::duration<double, std::milli> _waitTotal{};
+};
+
 struct RenderContext {
+    FrameSync frameSync{2};
+    GpuMemoryRegistry memory{};
+
     RenderContext() {
         gl3wInit();
 
@@ -93,11 +203,37 @@ struct RenderContext {
         return program;
     }
 
+    GLuint createComputeShader(std::string_view source) {
+        auto compute = compileShader(source, GL_COMPUTE_SHADER);
+
+        GLuint program = glCreateProgram();
+        glAttachShader(program, compute);
+        glLinkProgram(program);
+        glDeleteShader(compute);
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        if (length > 0) {
+            std::basic_string<char> infoLog{};
+            infoLog.resize(length);
+            glGetProgramInfoLog(program, length, &length, &infoLog[0]);
+            fmt::print("{}\n", infoLog);
+        }
+
+        GLint status = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status == GL_FALSE) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
     GLuint createFramebuffer(GLuint color_attachment, GLuint depth_attachment) {
         GLuint framebuffer;
         glCreateFramebuffers(1, &framebuffer);
         glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, color_attachment, 0);
-        glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_attachment);
+        glNamedFramebufferTexture(framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, depth_attachment, 0);
         return framebuffer;
     }
 
@@ -105,15 +241,21 @@ struct RenderContext {
         GLuint color_attachment;
         glCreateTextures(GL_TEXTURE_2D, 1, &color_attachment);
         glTextureStorage2D(color_attachment, 1, GL_RGB8, width, height);
+        memory.track(GpuResource::Texture, color_attachment, GpuMemoryCategory::RenderTarget, GpuMemoryRegistry::textureBytes(GL_RGB8, width, height));
         glTextureParameteri(color_attachment, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTextureParameteri(color_attachment, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         return color_attachment;
     }
 
+    // A texture rather than a renderbuffer so that passes such as the depth pyramid can sample it.
     GLuint createDepthAttachment(int width, int height) {
         GLuint depth_attachment;
-        glCreateRenderbuffers(1, &depth_attachment);
-        glNamedRenderbufferStorage(depth_attachment, GL_DEPTH32F_STENCIL8, width, height);
+        glCreateTextures(GL_TEXTURE_2D, 1, &depth_attachment);
+        glTextureStorage2D(depth_attachment, 1, GL_DEPTH32F_STENCIL8, width, height);
+        glTextureParameteri(depth_attachment, GL_DEPTH_STENCIL_TEXTURE_MODE, GL_DEPTH_COMPONENT);
+        glTextureParameteri(depth_attachment, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(depth_attachment, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        memory.track(GpuResource::Texture, depth_attachment, GpuMemoryCategory::RenderTarget, GpuMemoryRegistry::textureBytes(GL_DEPTH32F_STENCIL8, width, height));
         return depth_attachment;
     }
 
@@ -131,6 +273,7 @@ struct RenderContext {
         renderTarget->framebuffer = framebuffer;
         renderTarget->color_attachment = color_attachment;
         renderTarget->depth_attachment = depth_attachment;
+        renderTarget->memory = &memory;
         return renderTarget;
     }
 
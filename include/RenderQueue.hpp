@@ -0,0 +1,212 @@
+#pragma once
+
+#include <GL/gl3w.h>
+#include <MeshHeap.hpp>
+#include <UniformAllocator.hpp>
+#include <utils/parallel.hpp>
+
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <bit>
+
+enum class RenderPass : uint8_t {
+    Opaque,     /// state first, then front to back
+    Transparent /// back to front, then state
+};
+
+struct DrawCommand {
+    GLuint program = GL_NONE;
+    GLuint vao = GL_NONE;
+    GLuint texture = GL_NONE; /// bound to unit 0, GL_NONE leaves the unit alone
+    MeshRange range{};
+    UniformAllocation uniforms{};
+    GLuint uniform_binding = 1;
+    GLenum mode = GL_TRIANGLES;
+};
+
+struct RenderQueueStats {
+    size_t commands = 0;
+    size_t program_changes = 0;
+    size_t vao_changes = 0;
+    size_t texture_changes = 0;
+    double sort_ms = 0.0;
+};
+
+// Collects draws for a frame and submits them ordered by a 64-bit key:
+//   opaque:      pass:4 | program:12 | vao:12 | texture:12 | depth:24
+//   transparent: pass:4 | ~depth:24  | program:12 | vao:12 | texture:12
+// so opaque geometry is grouped by state and drawn front to back within a group, which lets the
+// GL_GREATER depth test reject occluded fragments early. GL names are remapped to small dense ids.
+// Keys are ordered with an LSD radix sort whose histogram and scatter steps run on the thread pool.
+struct RenderQueue {
+    static constexpr size_t RADIX_CHUNK = 4096; /// minimum commands per sort task
+
+    void submit(RenderPass pass, const DrawCommand& command, float depth) {
+        const auto program = id(_programs, command.program);
+        const auto vao = id(_vaos, command.vao);
+        const auto texture = id(_textures, command.texture);
+        const auto z = quantizeDepth(depth);
+
+        uint64_t key = uint64_t(pass) << 60;
+        if (pass == RenderPass::Opaque) {
+            key |= program << 48 | vao << 36 | texture << 24 | z;
+        } else {
+            key |= uint64_t(~z & 0xFFFFFF) << 36 | program << 24 | vao << 12 | texture;
+        }
+
+        _items.push_back(Item{key, static_cast<uint32_t>(_commands.size())});
+        _commands.push_back(command);
+    }
+
+    // Sorts, issues every command and clears the queue; GL state that was changed is left as is.
+    void execute() {
+        const auto sort_start = std::chrono::steady_clock::now();
+        sort();
+        _stats = RenderQueueStats{};
+        _stats.commands = _commands.size();
+        _stats.sort_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sort_start).count();
+
+        auto program = GL_INVALID_INDEX;
+        auto vao = GL_INVALID_INDEX;
+        auto texture = GL_INVALID_INDEX;
+        auto uniforms = UniformAllocation{GL_INVALID_INDEX};
+        auto uniform_binding = GL_INVALID_INDEX;
+        for (const auto& item : _items) {
+            const auto& command = _commands[item.command];
+            if (command.program != program) {
+                program = command.program;
+                glUseProgram(program);
+                _stats.program_changes += 1;
+            }
+            if (command.vao != vao) {
+                vao = command.vao;
+                glBindVertexArray(vao);
+                _stats.vao_changes += 1;
+            }
+            if (command.texture != GL_NONE && command.texture != texture) {
+                texture = command.texture;
+                glBindTextureUnit(0, texture);
+                _stats.texture_changes += 1;
+            }
+            if (command.uniforms.buffer != GL_NONE && !sameRange(command.uniforms, command.uniform_binding, uniforms, uniform_binding)) {
+                uniforms = command.uniforms;
+                uniform_binding = command.uniform_binding;
+                uniforms.bind(uniform_binding);
+            }
+
+            const auto& r = command.range;
+            const auto offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(r.first_index) * sizeof(uint32_t));
+            glDrawElementsBaseVertex(command.mode, static_cast<GLsizei>(r.index_count), GL_UNSIGNED_INT, offset, r.base_vertex);
+        }
+
+        _items.clear();
+        _commands.clear();
+    }
+
+    size_t size() const {
+        return _commands.size();
+    }
+
+    // Counters of the last execute().
+    const RenderQueueStats& stats() const {
+        return _stats;
+    }
+
+private:
+    struct Item {
+        uint64_t key;
+        uint32_t command;
+    };
+
+    static constexpr uint64_t ID_MASK = (1 << 12) - 1;
+
+    // GL names get dense ids in order of first use; past 4095 they share the last id, which only
+    // costs grouping. Id 0 is reserved for GL_NONE.
+    static uint64_t id(std::unordered_map<GLuint, uint64_t>& ids, GLuint name) {
+        if (name == GL_NONE) {
+            return 0;
+        }
+        const auto [it, inserted] = ids.try_emplace(name, std::min<uint64_t>(ids.size() + 1, ID_MASK));
+        return it->second;
+    }
+
+    static bool sameRange(const UniformAllocation& a, GLuint a_binding, const UniformAllocation& b, GLuint b_binding) {
+        return a_binding == b_binding && a.buffer == b.buffer && a.offset == b.offset && a.size == b.size;
+    }
+
+    // Bit patterns of non-negative floats order like the floats; keep exponent and top mantissa bits.
+    static uint64_t quantizeDepth(float depth) {
+        return std::bit_cast<uint32_t>(std::max(depth, 0.0f)) >> 7;
+    }
+
+    void sort() {
+        const auto count = _items.size();
+        if (count < 2) {
+            return;
+        }
+
+        const auto chunks = std::clamp<size_t>(count / RADIX_CHUNK, 1, ThreadPool::instance().concurrency());
+        const auto chunk_size = (count + chunks - 1) / chunks;
+        _scratch.resize(count);
+        _histograms.resize(chunks);
+
+        auto* src = &_items;
+        auto* dst = &_scratch;
+        for (uint32_t shift = 0; shift < 64; shift += 8) {
+            parallelFor(chunks, [&](size_t c) {
+                auto& histogram = _histograms[c];
+                histogram.fill(0);
+                const auto end = std::min(count, (c + 1) * chunk_size);
+                for (size_t i = c * chunk_size; i < end; ++i) {
+                    histogram[((*src)[i].key >> shift) & 0xFF] += 1;
+                }
+            });
+
+            /// digit offsets per chunk; a byte shared by every key leaves the order unchanged
+            size_t offset = 0;
+            bool uniform = false;
+            for (size_t digit = 0; digit < 256; ++digit) {
+                size_t total = 0;
+                for (auto& histogram : _histograms) {
+                    const auto n = histogram[digit];
+                    histogram[digit] = offset + total;
+                    total += n;
+                }
+                uniform = uniform || total == count;
+                offset += total;
+            }
+            if (uniform) {
+                continue;
+            }
+
+            parallelFor(chunks, [&](size_t c) {
+                auto& histogram = _histograms[c];
+                const auto end = std::min(count, (c + 1) * chunk_size);
+                for (size_t i = c * chunk_size; i < end; ++i) {
+                    const auto& item = (*src)[i];
+                    (*dst)[histogram[(item.key >> shift) & 0xFF]++] = item;
+                }
+            });
+            std::swap(src, dst);
+        }
+
+        if (src != &_items) {
+            std::swap(_items, _scratch);
+        }
+    }
+
+    std::vector<Item> _items{};
+    std::vector<Item> _scratch{};
+    std::vector<DrawCommand> _commands{};
+    std::vector<std::array<size_t, 256>> _histograms{};
+
+    std::unordered_map<GLuint, uint64_t> _programs{};
+    std::unordered_map<GLuint, uint64_t> _vaos{};
+    std::unordered_map<GLuint, uint64_t> _textures{};
+
+    RenderQueueStats _stats{};
+};
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <GL/gl3w.h>
+#include <RenderContext.hpp>
+#include <Image.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <limits>
+#include <vector>
+
+struct AtlasRegion {
+    glm::u32 layer;
+    glm::uvec2 offset; /// texel offset of the image inside its layer, padding excluded
+    glm::uvec2 size;
+    glm::vec4 uv;      /// min.xy, max.xy
+};
+
+// Bottom-left skyline rectangle packer. Rectangles can be inserted one at a time at any point;
+// nothing already placed ever moves.
+struct SkylinePacker {
+    SkylinePacker(glm::u32 width, glm::u32 height) : _width(width), _height(height) {
+        clear();
+    }
+
+    void clear() {
+        _skyline.assign(1, Segment{0, 0, _width});
+        _used_area = 0;
+    }
+
+    std::optional<glm::uvec2> insert(glm::u32 width, glm::u32 height) {
+        if (width == 0 || height == 0 || width > _width || height > _height) {
+            return std::nullopt;
+        }
+
+        size_t best_index = _skyline.size();
+        glm::u32 best_top = std::numeric_limits<glm::u32>::max();
+        glm::u32 best_width = std::numeric_limits<glm::u32>::max();
+        glm::u32 best_y = 0;
+
+        for (size_t i = 0; i < _skyline.size(); ++i) {
+            if (const auto y = fit(i, width, height)) {
+                const auto top = *y + height;
+                if (top < best_top || (top == best_top && _skyline[i].width < best_width)) {
+                    best_index = i;
+                    best_top = top;
+                    best_width = _skyline[i].width;
+                    best_y = *y;
+                }
+            }
+        }
+
+        if (best_index == _skyline.size()) {
+            return std::nullopt;
+        }
+
+        const auto x = _skyline[best_index].x;
+        place(best_index, Segment{x, best_y + height, width});
+        _used_area += static_cast<uint64_t>(width) * height;
+        return glm::uvec2{x, best_y};
+    }
+
+    float occupancy() const {
+        return static_cast<float>(static_cast<double>(_used_area) / (static_cast<double>(_width) * _height));
+    }
+
+private:
+    struct Segment {
+        glm::u32 x;
+        glm::u32 y;
+        glm::u32 width;
+    };
+
+    // Lowest y at which a width x height rectangle starting at segment `index` rests on the skyline.
+    std::optional<glm::u32> fit(size_t index, glm::u32 width, glm::u32 height) const {
+        const auto x = _skyline[index].x;
+        if (x + width > _width) {
+            return std::nullopt;
+        }
+
+        glm::u32 y = 0;
+        glm::u32 remaining = width;
+        for (size_t i = index; remaining > 0; ++i) {
+            y = std::max(y, _skyline[i].y);
+            if (y + height > _height) {
+                return std::nullopt;
+            }
+            remaining -= std::min(remaining, _skyline[i].width);
+        }
+        return y;
+    }
+
+    void place(size_t index, const Segment& segment) {
+        _skyline.insert(_skyline.begin() + static_cast<std::ptrdiff_t>(index), segment);
+
+        const auto right = segment.x + segment.width;
+        for (size_t i = index + 1; i < _skyline.size();) {
+            auto& next = _skyline[i];
+            if (next.x >= right) {
+                break;
+            }
+            const auto overlap = right - next.x;
+            if (overlap < next.width) {
+                next.x += overlap;
+                next.width -= overlap;
+                break;
+            }
+            _skyline.erase(_skyline.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+
+        for (size_t i = 0; i + 1 < _skyline.size();) {
+            if (_skyline[i].y == _skyline[i + 1].y) {
+                _skyline[i].width += _skyline[i + 1].width;
+                _skyline.erase(_skyline.begin() + static_cast<std::ptrdiff_t>(i + 1));
+            } else {
+                i += 1;
+            }
+        }
+    }
+
+    glm::u32 _width;
+    glm::u32 _height;
+    uint64_t _used_area = 0;
+    std::vector<Segment> _skyline{};
+};
+
+// Packs many small images into the layers of one GL_TEXTURE_2D_ARRAY, so everything added here can be
+// drawn with a single texture binding. Each layer is a skyline page; a new layer is opened when no
+// existing one has room, and the array storage doubles (with a GPU-side copy) when it runs out of layers.
+// Images are surrounded by `padding` texels of extruded edge to keep linear filtering from bleeding.
+struct TextureAtlas {
+    TextureAtlas(RenderContext& renderContext, glm::u32 size = 2048, glm::u32 capacity = 1, glm::u32 padding = 1)
+        : _memory(renderContext.memory)
+        , _size(size)
+        , _padding(padding) {
+        reserve(capacity);
+    }
+
+    ~TextureAtlas() {
+        releaseViews();
+        _memory.release(GpuResource::Texture, _handle);
+        glDeleteTextures(1, &_handle);
+    }
+
+    std::optional<AtlasRegion> add(const ImageData& image) {
+        const auto [width, height] = image.info();
+        if (width == 0 || height == 0) {
+            return std::nullopt;
+        }
+        const auto padded = glm::uvec2{width + _padding * 2, height + _padding * 2};
+
+        for (glm::u32 layer = 0; layer < _pages.size(); ++layer) {
+            if (const auto offset = _pages[layer].insert(padded.x, padded.y)) {
+                return upload(image, layer, *offset);
+            }
+        }
+
+        if (padded.x > _size || padded.y > _size) {
+            return std::nullopt;
+        }
+
+        if (_pages.size() == _capacity) {
+            GLint max_layers = 0;
+            glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+            if (_capacity >= static_cast<glm::u32>(max_layers)) {
+                return std::nullopt;
+            }
+            reserve(std::min(_capacity * 2, static_cast<glm::u32>(max_layers)));
+        }
+
+        const auto layer = static_cast<glm::u32>(_pages.size());
+        const auto offset = _pages.emplace_back(_size, _size).insert(padded.x, padded.y);
+        return upload(image, layer, *offset);
+    }
+
+    // GL_TEXTURE_2D_ARRAY holding every layer. Changes when the array grows.
+    GLuint handle() const {
+        return _handle;
+    }
+
+    // GL_TEXTURE_2D view of a single layer, for samplers that can't take arrays (e.g. ImGui::Image).
+    GLuint layerView(glm::u32 layer) {
+        if (_views.size() <= layer) {
+            _views.resize(layer + 1, GL_NONE);
+        }
+        if (_views[layer] == GL_NONE) {
+            glGenTextures(1, &_views[layer]);
+            glTextureView(_views[layer], GL_TEXTURE_2D, _handle, GL_RGBA8, 0, 1, layer, 1);
+        }
+        return _views[layer];
+    }
+
+    glm::u32 layers() const {
+        return static_cast<glm::u32>(_pages.size());
+    }
+
+    glm::u32 size() const {
+        return _size;
+    }
+
+private:
+    AtlasRegion upload(const ImageData& image, glm::u32 layer, glm::uvec2 offset) {
+        const auto [width, height] = image.info();
+        const auto padded_width = width + _padding * 2;
+        const auto padded_height = height + _padding * 2;
+
+        _staging.resize(static_cast<size_t>(padded_width) * padded_height);
+        for (glm::u32 y = 0; y < padded_height; ++y) {
+            const auto sy = std::min(height - 1, y - std::min(y, _padding));
+            for (glm::u32 x = 0; x < padded_width; ++x) {
+                const auto sx = std::min(width - 1, x - std::min(x, _padding));
+                _staging[static_cast<size_t>(y) * padded_width + x] = image.get(sx, sy);
+            }
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTextureSubImage3D(
+            _handle,
+            0,
+            static_cast<GLint>(offset.x),
+            static_cast<GLint>(offset.y),
+            static_cast<GLint>(layer),
+            static_cast<GLsizei>(padded_width),
+            static_cast<GLsizei>(padded_height),
+            1,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            _staging.data()
+        );
+
+        const auto origin = offset + glm::uvec2(_padding);
+        const auto scale = 1.0f / static_cast<float>(_size);
+        return AtlasRegion{
+            .layer = layer,
+            .offset = origin,
+            .size = {width, height},
+            .uv = glm::vec4(
+                static_cast<float>(origin.x) * scale,
+                static_cast<float>(origin.y) * scale,
+                static_cast<float>(origin.x + width) * scale,
+                static_cast<float>(origin.y + height) * scale
+            )
+        };
+    }
+
+    void reserve(glm::u32 capacity) {
+        GLuint handle = GL_NONE;
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &handle);
+        glTextureStorage3D(handle, 1, GL_RGBA8, static_cast<GLsizei>(_size), static_cast<GLsizei>(_size), static_cast<GLsizei>(capacity));
+        _memory.track(GpuResource::Texture, handle, GpuMemoryCategory::Texture, GpuMemoryRegistry::textureBytes(GL_RGBA8, static_cast<GLsizei>(_size), static_cast<GLsizei>(_size), 1, static_cast<GLsizei>(capacity)));
+        glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        if (_handle != GL_NONE) {
+            if (!_pages.empty()) {
+                const auto size = static_cast<GLsizei>(_size);
+                glCopyImageSubData(_handle, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, handle, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, size, size, static_cast<GLsizei>(_pages.size()));
+            }
+            releaseViews();
+            _memory.release(GpuResource::Texture, _handle);
+            glDeleteTextures(1, &_handle);
+        }
+
+        _handle = handle;
+        _capacity = capacity;
+    }
+
+    void releaseViews() {
+        for (auto& view : _views) {
+            if (view != GL_NONE) {
+                glDeleteTextures(1, &view);
+            }
+        }
+        _views.clear();
+    }
+
+    GpuMemoryRegistry& _memory;
+    GLuint _handle = GL_NONE;
+    glm::u32 _size;
+    glm::u32 _padding;
+    glm::u32 _capacity = 0;
+    std::vector<SkylinePacker> _pages{};
+    std::vector<GLuint> _views{};
+    std::vector<glm::u8vec4> _staging{};
+};
@@ -0,0 +1,594 @@
+#pragma once
+
+#include <GL/gl3w.h>
+#include <Image.hpp>
+#include <ImageFilter.hpp>
+#include <utils/parallel.hpp>
+#include <utils/hash.hpp>
+
+#include <fmt/format.h>
+#include <filesystem>
+#include <algorithm>
+#include <optional>
+#include <fstream>
+#include <limits>
+#include <vector>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_COMPRESSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+enum class BlockFormat : uint32_t {
+    BC1, /// RGB + 1-bit alpha, 8 bytes per 4x4 block
+    BC3, /// RGB + interpolated alpha, 16 bytes per block
+    BC7  /// RGBA, mode 6 only, 16 bytes per block
+};
+
+struct CompressedImage {
+    BlockFormat format;
+    glm::u32 width;
+    glm::u32 height;
+    std::vector<uint8_t> blocks{};
+
+    static constexpr size_t blockBytes(BlockFormat format) {
+        return format == BlockFormat::BC1 ? 8 : 16;
+    }
+
+    static constexpr GLenum internalFormat(BlockFormat format) {
+        switch (format) {
+            case BlockFormat::BC1:
+                return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+            case BlockFormat::BC3:
+                return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case BlockFormat::BC7:
+                return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        }
+        return GL_NONE;
+    }
+
+    glm::u32 blocksWide() const {
+        return (width + 3) / 4;
+    }
+
+    glm::u32 blocksHigh() const {
+        return (height + 3) / 4;
+    }
+
+    // Bytes in one row of blocks.
+    size_t rowBytes() const {
+        return blocksWide() * blockBytes(format);
+    }
+};
+
+namespace detail {
+    // One 4x4 block of texels as floats in [0, 255], structure-of-arrays for the distance kernels.
+    struct Block {
+        alignas(16) std::array<float, 16> r;
+        alignas(16) std::array<float, 16> g;
+        alignas(16) std::array<float, 16> b;
+        alignas(16) std::array<float, 16> a;
+    };
+
+    // Index of the closest palette entry for every texel. The palette is also SoA, `size` is a multiple of 4.
+    template <size_t Size>
+    inline void nearest(const Block& block, const Block& palette, bool alpha, std::array<uint8_t, 16>& indices) {
+        for (size_t i = 0; i < 16; ++i) {
+#ifdef TEXTURE_COMPRESSION_SSE2
+            const auto pr = _mm_set1_ps(block.r[i]);
+            const auto pg = _mm_set1_ps(block.g[i]);
+            const auto pb = _mm_set1_ps(block.b[i]);
+            const auto pa = _mm_set1_ps(alpha ? block.a[i] : 0.0f);
+
+            auto best = _mm_set1_ps(std::numeric_limits<float>::max());
+            auto best_index = _mm_setzero_si128();
+            auto lane = _mm_set_epi32(3, 2, 1, 0);
+            for (size_t k = 0; k < Size; k += 4) {
+                const auto dr = _mm_sub_ps(pr, _mm_load_ps(palette.r.data() + k));
+                const auto dg = _mm_sub_ps(pg, _mm_load_ps(palette.g.data() + k));
+                const auto db = _mm_sub_ps(pb, _mm_load_ps(palette.b.data() + k));
+                const auto da = _mm_sub_ps(pa, alpha ? _mm_load_ps(palette.a.data() + k) : _mm_setzero_ps());
+                const auto d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(da, da)));
+
+                const auto less = _mm_cmplt_ps(d, best);
+                best = _mm_min_ps(d, best);
+                best_index = _mm_or_si128(_mm_and_si128(_mm_castps_si128(less), lane), _mm_andnot_si128(_mm_castps_si128(less), best_index));
+                lane = _mm_add_epi32(lane, _mm_set1_epi32(4));
+            }
+
+            alignas(16) std::array<float, 4> distances{};
+            alignas(16) std::array<int32_t, 4> lanes{};
+            _mm_store_ps(distances.data(), best);
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes.data()), best_index);
+
+            size_t winner = 0;
+            for (size_t k = 1; k < 4; ++k) {
+                if (distances[k] < distances[winner] || (distances[k] == distances[winner] && lanes[k] < lanes[winner])) {
+                    winner = k;
+                }
+            }
+            indices[i] = static_cast<uint8_t>(lanes[winner]);
+#else
+            float best = std::numeric_limits<float>::max();
+            for (size_t k = 0; k < Size; ++k) {
+                const auto dr = block.r[i] - palette.r[k];
+                const auto dg = block.g[i] - palette.g[k];
+                const auto db = block.b[i] - palette.b[k];
+                const auto da = alpha ? block.a[i] - palette.a[k] : 0.0f;
+                const auto d = dr * dr + dg * dg + db * db + da * da;
+                if (d < best) {
+                    best = d;
+                    indices[i] = static_cast<uint8_t>(k);
+                }
+            }
+#endif
+        }
+    }
+
+    inline glm::vec4 texel(const Block& block, size_t i) {
+        return {block.r[i], block.g[i], block.b[i], block.a[i]};
+    }
+
+    // Mean and principal axis of the block colours (alpha included when `alpha` is set).
+    inline std::pair<glm::vec4, glm::vec4> principalAxis(const Block& block, bool alpha) {
+        glm::vec4 mean{0.0f};
+        for (size_t i = 0; i < 16; ++i) {
+            mean += texel(block, i);
+        }
+        mean = mean / 16.0f;
+        if (!alpha) {
+            mean.w = 0.0f;
+        }
+
+        std::array<std::array<float, 4>, 4> cov{};
+        for (size_t i = 0; i < 16; ++i) {
+            auto d = texel(block, i) - mean;
+            if (!alpha) {
+                d.w = 0.0f;
+            }
+            for (int r = 0; r < 4; ++r) {
+                for (int c = 0; c < 4; ++c) {
+                    cov[r][c] += d[r] * d[c];
+                }
+            }
+        }
+
+        glm::vec4 axis{1.0f, 1.0f, 1.0f, alpha ? 1.0f : 0.0f};
+        for (int iteration = 0; iteration < 8; ++iteration) {
+            glm::vec4 next{0.0f};
+            for (int r = 0; r < 4; ++r) {
+                for (int c = 0; c < 4; ++c) {
+                    next[r] += cov[r][c] * axis[c];
+                }
+            }
+            const auto length = std::sqrt(glm::dot(next, next));
+            if (length < 1e-6f) {
+                break;
+            }
+            axis = next / length;
+        }
+        return {mean, axis};
+    }
+
+    // Extremes of the block projected onto its principal axis.
+    inline std::pair<glm::vec4, glm::vec4> endpoints(const Block& block, bool alpha) {
+        const auto [mean, axis] = principalAxis(block, alpha);
+
+        float lo = std::numeric_limits<float>::max();
+        float hi = std::numeric_limits<float>::lowest();
+        for (size_t i = 0; i < 16; ++i) {
+            auto d = texel(block, i) - mean;
+            if (!alpha) {
+                d.w = 0.0f;
+            }
+            const auto t = glm::dot(d, axis);
+            lo = std::min(lo, t);
+            hi = std::max(hi, t);
+        }
+        return {glm::clamp(mean + axis * lo, 0.0f, 255.0f), glm::clamp(mean + axis * hi, 0.0f, 255.0f)};
+    }
+
+    struct BitStream {
+        std::array<uint8_t, 16> bytes{};
+        uint32_t position = 0;
+
+        void write(uint32_t value, uint32_t count) {
+            for (uint32_t i = 0; i < count; ++i, ++position) {
+                bytes[position >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (position & 7));
+            }
+        }
+    };
+}
+
+// CPU block compression. Every 4x4 block is independent, so rows of blocks are encoded in parallel;
+// the palette distance searches use SSE2 where available.
+struct TextureCompressor {
+    static CompressedImage compress(const ImageData& image, BlockFormat format) {
+        CompressedImage result{format, image.info().width, image.info().height};
+        result.blocks.resize(result.rowBytes() * result.blocksHigh());
+
+        parallelFor(result.blocksHigh(), [&](size_t by) {
+            auto out = result.blocks.data() + by * result.rowBytes();
+            for (glm::u32 bx = 0; bx < result.blocksWide(); ++bx) {
+                const auto block = load(image, bx * 4, static_cast<glm::u32>(by) * 4);
+                switch (format) {
+                    case BlockFormat::BC1:
+                        encodeBC1(block, out, true);
+                        break;
+                    case BlockFormat::BC3:
+                        encodeBC3Alpha(block, out);
+                        encodeBC1(block, out + 8, false);
+                        break;
+                    case BlockFormat::BC7:
+                        encodeBC7(block, out);
+                        break;
+                }
+                out += CompressedImage::blockBytes(format);
+            }
+        });
+        return result;
+    }
+
+    static std::vector<CompressedImage> compress(std::span<const ImageData> levels, BlockFormat format) {
+        std::vector<CompressedImage> result{};
+        result.reserve(levels.size());
+        for (const auto& level : levels) {
+            result.push_back(compress(level, format));
+        }
+        return result;
+    }
+
+private:
+    static detail::Block load(const ImageData& image, glm::u32 x0, glm::u32 y0) {
+        const auto [width, height] = image.info();
+
+        detail::Block block{};
+        for (glm::u32 y = 0; y < 4; ++y) {
+            for (glm::u32 x = 0; x < 4; ++x) {
+                /// partial edge blocks repeat their last texel
+                const auto px = image.get(std::min(x0 + x, width - 1), std::min(y0 + y, height - 1));
+                const auto i = y * 4 + x;
+                block.r[i] = px.x;
+                block.g[i] = px.y;
+                block.b[i] = px.z;
+                block.a[i] = px.w;
+            }
+        }
+        return block;
+    }
+
+    static uint16_t pack565(const glm::vec4& c) {
+        const auto r = static_cast<uint16_t>(std::lround(c.x * 31.0f / 255.0f));
+        const auto g = static_cast<uint16_t>(std::lround(c.y * 63.0f / 255.0f));
+        const auto b = static_cast<uint16_t>(std::lround(c.z * 31.0f / 255.0f));
+        return static_cast<uint16_t>(r << 11 | g << 5 | b);
+    }
+
+    static glm::vec4 unpack565(uint16_t c) {
+        const auto r = (c >> 11) & 31;
+        const auto g = (c >> 5) & 63;
+        const auto b = c & 31;
+        return {
+            static_cast<float>((r << 3) | (r >> 2)),
+            static_cast<float>((g << 2) | (g >> 4)),
+            static_cast<float>((b << 3) | (b >> 2)),
+            255.0f
+        };
+    }
+
+    static void encodeBC1(const detail::Block& block, uint8_t* out, bool allow_transparent) {
+        bool transparent = false;
+        if (allow_transparent) {
+            for (const auto a : block.a) {
+                transparent |= a < 128.0f;
+            }
+        }
+
+        /// endpoints from opaque texels only; transparent ones take the dedicated index
+        auto opaque = block;
+        if (transparent) {
+            size_t first = 16;
+            for (size_t i = 0; i < 16; ++i) {
+                if (block.a[i] >= 128.0f) {
+                    first = std::min(first, i);
+                }
+            }
+            for (size_t i = 0; i < 16; ++i) {
+                if (block.a[i] < 128.0f && first < 16) {
+                    opaque.r[i] = block.r[first];
+                    opaque.g[i] = block.g[first];
+                    opaque.b[i] = block.b[first];
+                }
+            }
+        }
+
+        const auto [lo, hi] = detail::endpoints(opaque, false);
+        auto c0 = pack565(hi);
+        auto c1 = pack565(lo);
+
+        /// four-colour mode needs c0 > c1, three-colour + transparent mode needs c0 <= c1
+        if (transparent ? c0 > c1 : c0 < c1) {
+            std::swap(c0, c1);
+        }
+
+        std::array<uint8_t, 16> indices{};
+        if (!transparent && c0 == c1) {
+            indices.fill(0);
+        } else {
+            const auto e0 = unpack565(c0);
+            const auto e1 = unpack565(c1);
+
+            detail::Block palette{};
+            std::array<glm::vec4, 4> colors{};
+            if (!transparent) {
+                colors = {e0, e1, (e0 * 2.0f + e1) / 3.0f, (e0 + e1 * 2.0f) / 3.0f};
+            } else {
+                /// index 3 is transparent black; keep it out of the colour search
+                colors = {e0, e1, (e0 + e1) / 2.0f, glm::vec4(1e9f)};
+            }
+            for (size_t k = 0; k < 4; ++k) {
+                palette.r[k] = colors[k].x;
+                palette.g[k] = colors[k].y;
+                palette.b[k] = colors[k].z;
+            }
+            detail::nearest<4>(block, palette, false, indices);
+
+            if (transparent) {
+                for (size_t i = 0; i < 16; ++i) {
+                    if (block.a[i] < 128.0f) {
+                        indices[i] = 3;
+                    }
+                }
+            }
+        }
+
+        uint32_t bits = 0;
+        for (size_t i = 0; i < 16; ++i) {
+            bits |= static_cast<uint32_t>(indices[i]) << (i * 2);
+        }
+        out[0] = static_cast<uint8_t>(c0);
+        out[1] = static_cast<uint8_t>(c0 >> 8);
+        out[2] = static_cast<uint8_t>(c1);
+        out[3] = static_cast<uint8_t>(c1 >> 8);
+        out[4] = static_cast<uint8_t>(bits);
+        out[5] = static_cast<uint8_t>(bits >> 8);
+        out[6] = static_cast<uint8_t>(bits >> 16);
+        out[7] = static_cast<uint8_t>(bits >> 24);
+    }
+
+    static void encodeBC3Alpha(const detail::Block& block, uint8_t* out) {
+        const auto [lo, hi] = std::minmax_element(block.a.begin(), block.a.end());
+        const auto a0 = static_cast<uint8_t>(*hi);
+        const auto a1 = static_cast<uint8_t>(*lo);
+
+        /// eight-value mode (a0 > a1); a flat block uses index 0 everywhere
+        std::array<float, 8> palette{static_cast<float>(a0), static_cast<float>(a1)};
+        for (int k = 1; k < 7; ++k) {
+            palette[k + 1] = static_cast<float>(((7 - k) * a0 + k * a1) / 7);
+        }
+
+        uint64_t bits = 0;
+        for (size_t i = 0; i < 16; ++i) {
+            uint64_t best = 0;
+            if (a0 != a1) {
+                float best_distance = std::numeric_limits<float>::max();
+                for (uint64_t k = 0; k < 8; ++k) {
+                    const auto d = std::abs(block.a[i] - palette[k]);
+                    if (d < best_distance) {
+                        best_distance = d;
+                        best = k;
+                    }
+                }
+            }
+            bits |= best << (i * 3);
+        }
+
+        out[0] = a0;
+        out[1] = a1;
+        for (size_t i = 0; i < 6; ++i) {
+            out[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+        }
+    }
+
+    // BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a shared-per-endpoint p-bit, 4-bit indices.
+    // Quality comes from trying every p-bit combination and refining the endpoints by least squares.
+    static void encodeBC7(const detail::Block& block, uint8_t* out) {
+        static constexpr std::array<int, 16> WEIGHTS{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+        static constexpr int REFINE_PASSES = 2;
+
+        struct Candidate {
+            std::array<glm::ivec4, 2> endpoints{}; /// 7-bit values
+            std::array<int, 2> pbits{};
+            std::array<uint8_t, 16> indices{};
+            float error = std::numeric_limits<float>::max();
+        };
+
+        const auto quantize = [](const glm::vec4& c, int pbit) {
+            glm::ivec4 q{};
+            for (int k = 0; k < 4; ++k) {
+                q[k] = std::clamp(static_cast<int>(std::lround((c[k] - static_cast<float>(pbit)) / 2.0f)), 0, 127);
+            }
+            return q;
+        };
+        const auto expand = [](const glm::ivec4& q, int pbit) {
+            return glm::vec4(q * 2 + glm::ivec4(pbit));
+        };
+
+        const auto evaluate = [&](Candidate& candidate) {
+            const auto e0 = expand(candidate.endpoints[0], candidate.pbits[0]);
+            const auto e1 = expand(candidate.endpoints[1], candidate.pbits[1]);
+
+            detail::Block palette{};
+            std::array<glm::vec4, 16> colors{};
+            for (size_t k = 0; k < 16; ++k) {
+                for (int c = 0; c < 4; ++c) {
+                    colors[k][c] = static_cast<float>(((64 - WEIGHTS[k]) * static_cast<int>(e0[c]) + WEIGHTS[k] * static_cast<int>(e1[c]) + 32) >> 6);
+                }
+                palette.r[k] = colors[k].x;
+                palette.g[k] = colors[k].y;
+                palette.b[k] = colors[k].z;
+                palette.a[k] = colors[k].w;
+            }
+            detail::nearest<16>(block, palette, true, candidate.indices);
+
+            candidate.error = 0.0f;
+            for (size_t i = 0; i < 16; ++i) {
+                const auto d = detail::texel(block, i) - colors[candidate.indices[i]];
+                candidate.error += glm::dot(d, d);
+            }
+        };
+
+        auto [lo, hi] = detail::endpoints(block, true);
+
+        Candidate best{};
+        for (int pass = 0; pass <= REFINE_PASSES; ++pass) {
+            Candidate round_best{};
+            for (int p0 = 0; p0 < 2; ++p0) {
+                for (int p1 = 0; p1 < 2; ++p1) {
+                    Candidate candidate{};
+                    candidate.pbits = {p0, p1};
+                    candidate.endpoints = {quantize(lo, p0), quantize(hi, p1)};
+                    evaluate(candidate);
+                    if (candidate.error < round_best.error) {
+                        round_best = candidate;
+                    }
+                }
+            }
+            if (round_best.error < best.error) {
+                best = round_best;
+            }
+            if (best.error == 0.0f || pass == REFINE_PASSES) {
+                break;
+            }
+
+            /// least-squares endpoints for the chosen indices
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+            glm::vec4 ax{0.0f}, bx{0.0f};
+            for (size_t i = 0; i < 16; ++i) {
+                const auto w = static_cast<float>(WEIGHTS[round_best.indices[i]]) / 64.0f;
+                const auto x = detail::texel(block, i);
+                aa += (1.0f - w) * (1.0f - w);
+                ab += (1.0f - w) * w;
+                bb += w * w;
+                ax += x * (1.0f - w);
+                bx += x * w;
+            }
+            const auto det = aa * bb - ab * ab;
+            if (std::abs(det) < 1e-6f) {
+                break;
+            }
+            lo = glm::clamp((ax * bb - bx * ab) / det, 0.0f, 255.0f);
+            hi = glm::clamp((bx * aa - ax * ab) / det, 0.0f, 255.0f);
+        }
+
+        /// the anchor (first) index has an implicit zero MSB
+        if (best.indices[0] >= 8) {
+            std::swap(best.endpoints[0], best.endpoints[1]);
+            std::swap(best.pbits[0], best.pbits[1]);
+            for (auto& index : best.indices) {
+                index = static_cast<uint8_t>(15 - index);
+            }
+        }
+
+        detail::BitStream stream{};
+        stream.write(1 << 6, 7);
+        for (int c = 0; c < 4; ++c) {
+            stream.write(static_cast<uint32_t>(best.endpoints[0][c]), 7);
+            stream.write(static_cast<uint32_t>(best.endpoints[1][c]), 7);
+        }
+        stream.write(static_cast<uint32_t>(best.pbits[0]), 1);
+        stream.write(static_cast<uint32_t>(best.pbits[1]), 1);
+        stream.write(best.indices[0], 3);
+        for (size_t i = 1; i < 16; ++i) {
+            stream.write(best.indices[i], 4);
+        }
+        std::copy(stream.bytes.begin(), stream.bytes.end(), out);
+    }
+};
+
+// Keeps compressed results on disk, keyed by a hash of the source pixels and the target format,
+// so unchanged images are only ever compressed once.
+struct CompressionCache {
+    explicit CompressionCache(std::filesystem::path directory) : _directory(std::move(directory)) {
+        std::error_code ec;
+        std::filesystem::create_directories(_directory, ec);
+    }
+
+    CompressedImage get(const ImageData& image, BlockFormat format) {
+        const auto path = pathFor(image, format);
+        if (auto cached = read(path, image, format)) {
+            return std::move(*cached);
+        }
+
+        auto result = TextureCompressor::compress(image, format);
+        write(path, result);
+        return result;
+    }
+
+private:
+    static constexpr uint32_t MAGIC = 0x31434342; /// "BCC1"
+
+    struct Header {
+        uint32_t magic;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    std::filesystem::path pathFor(const ImageData& image, BlockFormat format) const {
+        const auto hash = Hash64::compute(image.pixels(), static_cast<uint64_t>(format) << 32 | image.info().width);
+        return _directory / fmt::format("{:016x}.bc", hash);
+    }
+
+    static std::optional<CompressedImage> read(const std::filesystem::path& path, const ImageData& image, BlockFormat format) {
+        std::ifstream file{path, std::ios::binary};
+        if (!file) {
+            return std::nullopt;
+        }
+
+        Header header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || header.magic != MAGIC || header.format != static_cast<uint32_t>(format) || header.width != image.info().width || header.height != image.info().height) {
+            return std::nullopt;
+        }
+
+        CompressedImage result{format, header.width, header.height};
+        result.blocks.resize(result.rowBytes() * result.blocksHigh());
+        file.read(reinterpret_cast<char*>(result.blocks.data()), static_cast<std::streamsize>(result.blocks.size()));
+        if (!file) {
+            return std::nullopt;
+        }
+        return result;
+    }
+
+    static void write(const std::filesystem::path& path, const CompressedImage& image) {
+        /// write to a temporary name first so a crash never leaves a truncated entry behind
+        auto temporary = path;
+        temporary += ".tmp";
+
+        std::ofstream file{temporary, std::ios::binary | std::ios::trunc};
+        if (!file) {
+            fmt::print("Failed to write compression cache entry '{}'\n", path.string());
+            return;
+        }
+
+        const Header header{MAGIC, static_cast<uint32_t>(image.format), image.width, image.height};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(image.blocks.data()), static_cast<std::streamsize>(image.blocks.size()));
+        file.close();
+
+        std::error_code ec;
+        std::filesystem::rename(temporary, path, ec);
+    }
+
+    std::filesystem::path _directory;
+};
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <GL/gl3w.h>
+#include <RenderContext.hpp>
+#include <Image.hpp>
+#include <ImageFilter.hpp>
+#include <TextureCompression.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <variant>
+#include <vector>
+#include <deque>
+#include <bit>
+
+enum class MipGeneration {
+    None,   /// single level
+    Device, /// glGenerateTextureMipmap once the base level is uploaded
+    Host    /// mip chain is built by ImageFilter::buildMipChain and streamed with the base level
+};
+
+struct Texture {
+    GLuint handle = GL_NONE;
+    GLenum format = GL_RGBA8;
+    glm::u32 width = 0;
+    glm::u32 height = 0;
+    GLsizei levels = 1;
+    bool ready = false;
+};
+
+// Creates immutable textures from ImageData (RGBA8) or CompressedImage (BCn) and streams their contents through a persistently
+// mapped pixel-unpack ring. Each update() uploads at most `frame_budget` bytes and never waits on the
+// GPU: if the ring has no free space the remaining work simply moves on to the next frame.
+struct TextureManager {
+    TextureManager(RenderContext& renderContext, GLsizeiptr staging_size = 16 << 20, GLsizeiptr frame_budget = 4 << 20)
+        : _memory(renderContext.memory)
+        , _staging_size(staging_size)
+        , _frame_budget(frame_budget) {
+        static constexpr auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glCreateBuffers(1, &_staging);
+        glNamedBufferStorage(_staging, _staging_size, nullptr, flags);
+        _mapped = static_cast<std::byte*>(glMapNamedBufferRange(_staging, 0, _staging_size, flags));
+        _memory.track(GpuResource::Buffer, _staging, GpuMemoryCategory::Staging, static_cast<size_t>(_staging_size));
+    }
+
+    ~TextureManager() {
+        for (auto& fence : _fences) {
+            glDeleteSync(fence.sync);
+        }
+        for (auto& texture : _textures) {
+            _memory.release(GpuResource::Texture, texture->handle);
+            glDeleteTextures(1, &texture->handle);
+        }
+        _memory.release(GpuResource::Buffer, _staging);
+        glUnmapNamedBuffer(_staging);
+        glDeleteBuffers(1, &_staging);
+    }
+
+    // Returns nullptr for an image without pixels, as do the overloads below.
+    Texture* create(ImageData image, MipGeneration mips = MipGeneration::Device, const MipChainOptions& options = {}) {
+        if (image.info().width == 0 || image.info().height == 0) {
+            return nullptr;
+        }
+        if (mips == MipGeneration::Host) {
+            return create(ImageFilter::buildMipChain(image, options));
+        }
+
+        const auto [width, height] = image.info();
+        const auto levels = mips == MipGeneration::None ? 1 : static_cast<GLsizei>(std::bit_width(std::max(width, height)));
+
+        auto texture = createStorage(width, height, levels, GL_RGBA8);
+        _uploads.push_back(Upload{texture, std::move(image), 0, 0, mips == MipGeneration::Device, true});
+        return texture;
+    }
+
+    // Uploads a precomputed chain, e.g. from ImageFilter::buildMipChain; levels[0] is the base level.
+    Texture* create(std::vector<ImageData> levels) {
+        if (levels.empty() || levels.front().info().width == 0 || levels.front().info().height == 0) {
+            return nullptr;
+        }
+        const auto [width, height] = levels.front().info();
+
+        auto texture = createStorage(width, height, static_cast<GLsizei>(levels.size()), GL_RGBA8);
+        for (size_t i = 0; i < levels.size(); ++i) {
+            _uploads.push_back(Upload{texture, std::move(levels[i]), static_cast<GLint>(i), 0, false, i + 1 == levels.size()});
+        }
+        return texture;
+    }
+
+    // Block-compressed chain from TextureCompressor or CompressionCache; uploaded with glCompressedTextureSubImage2D.
+    Texture* create(std::vector<CompressedImage> levels) {
+        if (levels.empty() || levels.front().width == 0 || levels.front().height == 0) {
+            return nullptr;
+        }
+        const auto format = CompressedImage::internalFormat(levels.front().format);
+        const auto width = levels.front().width;
+        const auto height = levels.front().height;
+
+        auto texture = createStorage(width, height, static_cast<GLsizei>(levels.size()), format);
+        for (size_t i = 0; i < levels.size(); ++i) {
+            _uploads.push_back(Upload{texture, std::move(levels[i]), static_cast<GLint>(i), 0, false, i + 1 == levels.size()});
+        }
+        return texture;
+    }
+
+    void destroy(Texture* texture) {
+        std::erase_if(_uploads, [texture](const Upload& upload) { return upload.texture == texture; });
+
+        auto it = std::find_if(_textures.begin(), _textures.end(), [texture](const auto& ptr) { return ptr.get() == texture; });
+        if (it != _textures.end()) {
+            _memory.release(GpuResource::Texture, texture->handle);
+            glDeleteTextures(1, &texture->handle);
+            _textures.erase(it);
+        }
+    }
+
+    // Call once per frame from the render thread.
+    void update() {
+        retireFences();
+
+        GLsizeiptr budget = _frame_budget;
+        bool issued = false;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _staging);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        while (!_uploads.empty() && budget > 0) {
+            auto& upload = _uploads.front();
+
+            const auto [width, height, row_bytes, row_count, data] = layout(upload.source);
+            const auto rows_left = static_cast<GLsizeiptr>(row_count - upload.row);
+
+            /// a row wider than the whole budget still goes out, alone, on an otherwise idle frame
+            auto rows = std::min(rows_left, std::max<GLsizeiptr>(budget / row_bytes, budget == _frame_budget ? 1 : 0));
+            if (rows == 0) {
+                break;
+            }
+
+            auto offset = allocate(rows * row_bytes);
+            while (!offset && rows > 1) {
+                rows /= 2;
+                offset = allocate(rows * row_bytes);
+            }
+            if (!offset) {
+                break;
+            }
+
+            const auto src = data.subspan(static_cast<size_t>(upload.row * row_bytes), static_cast<size_t>(rows * row_bytes));
+            std::memcpy(_mapped + *offset, src.data(), src.size());
+
+            const auto pointer = reinterpret_cast<const void*>(static_cast<intptr_t>(*offset));
+            if (std::holds_alternative<ImageData>(upload.source)) {
+                glTextureSubImage2D(
+                    upload.texture->handle,
+                    upload.level,
+                    0,
+                    static_cast<GLint>(upload.row),
+                    static_cast<GLsizei>(width),
+                    static_cast<GLsizei>(rows),
+                    GL_RGBA,
+                    GL_UNSIGNED_BYTE,
+                    pointer
+                );
+            } else {
+                /// rows are rows of 4x4 blocks; the last one may be cut short by the level height
+                const auto y = upload.row * 4;
+                glCompressedTextureSubImage2D(
+                    upload.texture->handle,
+                    upload.level,
+                    0,
+                    static_cast<GLint>(y),
+                    static_cast<GLsizei>(width),
+                    static_cast<GLsizei>(std::min<GLsizeiptr>(rows * 4, height - y)),
+                    upload.texture->format,
+                    static_cast<GLsizei>(src.size()),
+                    pointer
+                );
+            }
+
+            issued = true;
+            budget -= rows * row_bytes;
+            upload.row += static_cast<glm::u32>(rows);
+
+            if (upload.row == row_count) {
+                if (upload.generate_mips) {
+                    glGenerateTextureMipmap(upload.texture->handle);
+                }
+                if (upload.last) {
+                    upload.texture->ready = true;
+                }
+                _uploads.pop_front();
+            }
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (issued) {
+            _fences.push_back(Fence{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), _head});
+        }
+    }
+
+    size_t pending() const {
+        return _uploads.size();
+    }
+
+private:
+    struct Upload {
+        Texture* texture;
+        std::variant<ImageData, CompressedImage> source;
+        GLint level;
+        glm::u32 row;
+        bool generate_mips;
+        bool last;
+    };
+
+    struct Layout {
+        glm::u32 width;
+        glm::u32 height;
+        GLsizeiptr row_bytes;
+        glm::u32 row_count;
+        std::span<const std::byte> data;
+    };
+
+    static Layout layout(const std::variant<ImageData, CompressedImage>& source) {
+        if (const auto image = std::get_if<ImageData>(&source)) {
+            const auto [width, height] = image->info();
+            return {width, height, static_cast<GLsizeiptr>(width * sizeof(glm::u8vec4)), height, std::as_bytes(image->pixels())};
+        }
+        const auto& image = std::get<CompressedImage>(source);
+        return {image.width, image.height, static_cast<GLsizeiptr>(image.rowBytes()), image.blocksHigh(), std::as_bytes(std::span(image.blocks))};
+    }
+
+    Texture* createStorage(glm::u32 width, glm::u32 height, GLsizei levels, GLenum format) {
+        auto texture = std::make_unique<Texture>();
+        texture->width = width;
+        texture->height = height;
+        texture->levels = levels;
+        texture->format = format;
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture->handle);
+        glTextureStorage2D(texture->handle, levels, format, static_cast<GLsizei>(width), static_cast<GLsizei>(height));
+        _memory.track(GpuResource::Texture, texture->handle, GpuMemoryCategory::Texture, GpuMemoryRegistry::textureBytes(format, static_cast<GLsizei>(width), static_cast<GLsizei>(height), levels));
+        glTextureParameteri(texture->handle, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTextureParameteri(texture->handle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        return _textures.emplace_back(std::move(texture)).get();
+    }
+
+    struct Fence {
+        GLsync sync;
+        uint64_t end; /// ring position just past the data the fence protects
+    };
+
+    void retireFences() {
+        while (!_fences.empty()) {
+            const auto status = glClientWaitSync(_fences.front().sync, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                break;
+            }
+            _tail = _fences.front().end;
+            glDeleteSync(_fences.front().sync);
+            _fences.pop_front();
+        }
+    }
+
+    // Reserves `size` contiguous bytes from the ring without blocking; nullopt when it is full.
+    // _head and _tail grow monotonically, the physical offset is their value modulo the ring size.
+    std::optional<GLsizeiptr> allocate(GLsizeiptr size) {
+        static constexpr GLsizeiptr ALIGNMENT = 16;
+
+        size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (_head == _tail) {
+            /// nothing in flight, restart at the beginning instead of padding around the end
+            _head = 0;
+            _tail = 0;
+        }
+
+        const auto offset = static_cast<GLsizeiptr>(_head % _staging_size);
+        const auto padding = offset + size > _staging_size ? _staging_size - offset : 0;
+        if (_head + padding + size - _tail > static_cast<uint64_t>(_staging_size)) {
+            return std::nullopt;
+        }
+
+        _head += padding;
+        return static_cast<GLsizeiptr>(std::exchange(_head, _head + size) % _staging_size);
+    }
+
+    GpuMemoryRegistry& _memory;
+    GLuint _staging = GL_NONE;
+    std::byte* _mapped = nullptr;
+    GLsizeiptr _staging_size;
+    GLsizeiptr _frame_budget;
+
+    uint64_t _head = 0;
+    uint64_t _tail = 0;
+
+    std::deque<Fence> _fences{};
+    std::deque<Upload> _uploads{};
+    std::vector<std::unique_ptr<Texture>> _textures{};
+};
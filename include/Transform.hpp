@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <utility>
+
+struct Transform {
+    glm::vec2 rotation{};
+    glm::vec3 position{};
+
+    auto getRotationMatrix() const -> glm::mat4 {
+        return getRotationMatrix(rotation);
+    }
+
+    auto getTransformMatrix() const -> glm::mat4 {
+        return glm::translate(getRotationMatrix(), -position);
+    }
+
+    auto getTransformMatrix(glm::vec3 offset) const -> glm::mat4 {
+        return glm::translate(getRotationMatrix(), -(position + offset));
+    }
+
+    // Rows of the rotation matrix, without building it.
+    auto up() const -> glm::vec3 {
+        const auto [sy, cy, sp, cp] = sincos(rotation);
+        return {sp * sy, cp, -sp * cy};
+    }
+
+    auto forward() const -> glm::vec3 {
+        const auto [sy, cy, sp, cp] = sincos(rotation);
+        return {-cp * sy, sp, cp * cy};
+    }
+
+    auto right() const -> glm::vec3 {
+        const auto [sy, cy, sp, cp] = sincos(rotation);
+        return {cy, 0, sy};
+    }
+
+    static auto getRotationMatrix(const glm::vec2& rotation) -> glm::mat4 {
+        const auto [sy, cy, sp, cp] = sincos(rotation);
+
+        return {
+            cy, sp * sy, -cp * sy, 0,
+            0, cp, sp, 0,
+            sy, -sp * cy, cp * cy, 0,
+            0, 0, 0, 1
+        };
+    }
+
+private:
+    struct SinCos {
+        float sy, cy, sp, cp;
+    };
+
+    static auto sincos(const glm::vec2& rotation) -> SinCos {
+        const auto ry = glm::radians(rotation.x);
+        const auto rp = glm::radians(rotation.y);
+        return {glm::sin(ry), glm::cos(ry), glm::sin(rp), glm::cos(rp)};
+    }
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <Transform.hpp>
+#include <utils/parallel.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_STORE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace detail {
+#ifdef TRANSFORM_STORE_SSE2
+    // Four-lane sin and cos, Cephes single-precision polynomials (max error ~1 ulp for |x| < 8192).
+    inline void sincos(__m128 x, __m128& s, __m128& c) {
+        const auto sign_mask = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u)));
+
+        auto sign_sin = _mm_and_ps(x, sign_mask);
+        x = _mm_andnot_ps(sign_mask, x);
+
+        /// octant j (made even) and the reduced argument x - j * pi/4, in three steps for precision
+        auto j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+        j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+        const auto y = _mm_cvtepi32_ps(j);
+
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+
+        const auto swap_sign_sin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+        const auto poly_mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+        const auto sign_cos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+        sign_sin = _mm_xor_ps(sign_sin, swap_sign_sin);
+
+        const auto z = _mm_mul_ps(x, x);
+
+        auto pc = _mm_set1_ps(2.443315711809948e-5f);
+        pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(-1.388731625493765e-3f));
+        pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(4.166664568298827e-2f));
+        pc = _mm_mul_ps(_mm_mul_ps(pc, z), z);
+        pc = _mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+        pc = _mm_add_ps(pc, _mm_set1_ps(1.0f));
+
+        auto ps = _mm_set1_ps(-1.9515295891e-4f);
+        ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(8.3321608736e-3f));
+        ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(-1.6666654611e-1f));
+        ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), x), x);
+
+        /// octants 1 and 2 swap the polynomials
+        const auto sin = _mm_or_ps(_mm_and_ps(poly_mask, ps), _mm_andnot_ps(poly_mask, pc));
+        const auto cos = _mm_or_ps(_mm_and_ps(poly_mask, pc), _mm_andnot_ps(poly_mask, ps));
+
+        s = _mm_xor_ps(sin, sign_sin);
+        c = _mm_xor_ps(cos, sign_cos);
+    }
+
+    inline __m128 transform(const glm::mat4& m, __m128 v) {
+        auto r = _mm_mul_ps(_mm_loadu_ps(&m[0][0]), _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[1][0]), _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[2][0]), _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[3][0]), _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+        return r;
+    }
+#endif
+}
+
+// Structure-of-arrays storage for many object transforms. Rotation uses the same yaw/pitch convention
+// as Transform (degrees); the world matrix is translate(position) * rotation * scale. update() rebuilds
+// the world matrices of dirty objects and the view-projection products of dirty objects, or of every
+// object when the view-projection changed, four objects per SSE lane group and in parallel chunks.
+struct TransformStore {
+    static constexpr size_t CHUNK = 1024; /// objects per parallel task, a multiple of 4
+
+    uint32_t add(const glm::vec3& position = {}, const glm::vec2& rotation = {}, float scale = 1.0f) {
+        const auto index = static_cast<uint32_t>(size());
+        _x.push_back(position.x);
+        _y.push_back(position.y);
+        _z.push_back(position.z);
+        _yaw.push_back(rotation.x);
+        _pitch.push_back(rotation.y);
+        _scale.push_back(scale);
+        _dirty.push_back(1);
+        _world.emplace_back(1.0f);
+        _mvp.emplace_back(1.0f);
+        return index;
+    }
+
+    // Moves the last object into `index`; returns the old index of the moved object.
+    uint32_t remove(uint32_t index) {
+        const auto last = static_cast<uint32_t>(size() - 1);
+        for (auto array : {&_x, &_y, &_z, &_yaw, &_pitch, &_scale}) {
+            (*array)[index] = array->back();
+            array->pop_back();
+        }
+        _dirty[index] = 1;
+        _dirty.pop_back();
+        _world[index] = _world.back();
+        _world.pop_back();
+        _mvp[index] = _mvp.back();
+        _mvp.pop_back();
+        return last;
+    }
+
+    void setPosition(uint32_t index, const glm::vec3& position) {
+        _x[index] = position.x;
+        _y[index] = position.y;
+        _z[index] = position.z;
+        _dirty[index] = 1;
+    }
+
+    void setRotation(uint32_t index, const glm::vec2& rotation) {
+        _yaw[index] = rotation.x;
+        _pitch[index] = rotation.y;
+        _dirty[index] = 1;
+    }
+
+    void setScale(uint32_t index, float scale) {
+        _scale[index] = scale;
+        _dirty[index] = 1;
+    }
+
+    glm::vec3 position(uint32_t index) const {
+        return {_x[index], _y[index], _z[index]};
+    }
+
+    glm::vec2 rotation(uint32_t index) const {
+        return {_yaw[index], _pitch[index]};
+    }
+
+    float scale(uint32_t index) const {
+        return _scale[index];
+    }
+
+    size_t size() const {
+        return _x.size();
+    }
+
+    const std::vector<glm::mat4>& world() const {
+        return _world;
+    }
+
+    const std::vector<glm::mat4>& mvp() const {
+        return _mvp;
+    }
+
+    void update(const glm::mat4& view_projection) {
+        const auto all = std::memcmp(&view_projection, &_view_projection, sizeof(glm::mat4)) != 0;
+        _view_projection = view_projection;
+
+        const auto chunks = (size() + CHUNK - 1) / CHUNK;
+        parallelFor(chunks, [this, all](size_t chunk) {
+            const auto begin = chunk * CHUNK;
+            const auto end = std::min(begin + CHUNK, size());
+            updateRange(begin, end, all);
+        });
+    }
+
+private:
+    void updateRange(size_t begin, size_t end, bool all) {
+        size_t i = begin;
+#ifdef TRANSFORM_STORE_SSE2
+        for (; i + 4 <= end; i += 4) {
+            uint32_t dirty;
+            std::memcpy(&dirty, &_dirty[i], sizeof(dirty));
+            if (dirty == 0 && !all) {
+                continue;
+            }
+            if (dirty != 0) {
+                worldSse(i);
+                std::memset(&_dirty[i], 0, 4);
+            }
+            for (size_t k = 0; k < 4; ++k) {
+                mvpSse(i + k);
+            }
+        }
+#endif
+        for (; i < end; ++i) {
+            if (_dirty[i] == 0 && !all) {
+                continue;
+            }
+            if (_dirty[i] != 0) {
+                auto world = Transform::getRotationMatrix({_yaw[i], _pitch[i]}) * _scale[i];
+                world[3] = glm::vec4(_x[i], _y[i], _z[i], 1.0f);
+                _world[i] = world;
+                _dirty[i] = 0;
+            }
+            _mvp[i] = _view_projection * _world[i];
+        }
+    }
+
+#ifdef TRANSFORM_STORE_SSE2
+    void worldSse(size_t i) {
+        const auto radians = _mm_set1_ps(0.01745329251994329577f);
+
+        __m128 sy, cy, sp, cp;
+        detail::sincos(_mm_mul_ps(_mm_loadu_ps(&_yaw[i]), radians), sy, cy);
+        detail::sincos(_mm_mul_ps(_mm_loadu_ps(&_pitch[i]), radians), sp, cp);
+        const auto s = _mm_loadu_ps(&_scale[i]);
+        const auto zero = _mm_setzero_ps();
+
+        /// one register per matrix element across the four objects, transposed into per-object columns
+        __m128 columns[4][4] = {
+            {_mm_mul_ps(cy, s), _mm_mul_ps(_mm_mul_ps(sp, sy), s), _mm_mul_ps(_mm_sub_ps(zero, _mm_mul_ps(cp, sy)), s), zero},
+            {zero, _mm_mul_ps(cp, s), _mm_mul_ps(sp, s), zero},
+            {_mm_mul_ps(sy, s), _mm_mul_ps(_mm_sub_ps(zero, _mm_mul_ps(sp, cy)), s), _mm_mul_ps(_mm_mul_ps(cp, cy), s), zero},
+            {_mm_loadu_ps(&_x[i]), _mm_loadu_ps(&_y[i]), _mm_loadu_ps(&_z[i]), _mm_set1_ps(1.0f)},
+        };
+
+        for (size_t c = 0; c < 4; ++c) {
+            auto& column = columns[c];
+            _MM_TRANSPOSE4_PS(column[0], column[1], column[2], column[3]);
+            for (size_t k = 0; k < 4; ++k) {
+                _mm_storeu_ps(&_world[i + k][c][0], column[k]);
+            }
+        }
+    }
+
+    void mvpSse(size_t i) {
+        const auto& world = _world[i];
+        auto& mvp = _mvp[i];
+        for (int c = 0; c < 4; ++c) {
+            _mm_storeu_ps(&mvp[c][0], detail::transform(_view_projection, _mm_loadu_ps(&world[c][0])));
+        }
+    }
+#endif
+
+    std::vector<float> _x{};
+    std::vector<float> _y{};
+    std::vector<float> _z{};
+    std::vector<float> _yaw{};
+    std::vector<float> _pitch{};
+    std::vector<float> _scale{};
+    std::vector<uint8_t> _dirty{};
+
+    std::vector<glm::mat4> _world{};
+    std::vector<glm::mat4> _mvp{};
+    glm::mat4 _view_projection{0.0f};
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <GL/gl3w.h>
+#include <RenderContext.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct UniformAllocation {
+    GLuint buffer = GL_NONE;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+    std::byte* pointer = nullptr;
+
+    void bind(GLuint index) const {
+        glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+    }
+};
+
+// Per-frame bump allocator for uniform data. Every FrameSync slot owns its own persistently mapped,
+// coherent pages; allocations are aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT and bound with
+// glBindBufferRange. A frame that outgrows its first page spills into additional pages, which are
+// kept for reuse. FrameSync::begin() guarantees the GPU is done with a slot before it is rewritten.
+struct UniformAllocator {
+    explicit UniformAllocator(RenderContext& renderContext, GLsizeiptr page_size = 4 << 20)
+        : _sync(renderContext.frameSync)
+        , _memory(renderContext.memory)
+        , _page_size(page_size) {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        _alignment = std::max<GLsizeiptr>(alignment, 16);
+
+        _frames.resize(FrameSync::MAX_DEPTH);
+    }
+
+    ~UniformAllocator() {
+        for (auto& frame : _frames) {
+            for (auto& page : frame.pages) {
+                _memory.release(GpuResource::Buffer, page.handle);
+                glUnmapNamedBuffer(page.handle);
+                glDeleteBuffers(1, &page.handle);
+            }
+        }
+    }
+
+    UniformAllocation allocate(GLsizeiptr size) {
+        auto& frame = _frames[_sync.index()];
+        if (frame.frame != _sync.frame()) {
+            /// first allocation of this frame, the slot has already been waited on
+            frame.frame = _sync.frame();
+            frame.page = 0;
+            frame.offset = 0;
+        }
+
+        const auto aligned = (size + _alignment - 1) / _alignment * _alignment;
+        if (frame.page < frame.pages.size() && frame.offset + aligned > frame.pages[frame.page].size) {
+            frame.page += 1;
+            frame.offset = 0;
+        }
+        if (frame.page == frame.pages.size()) {
+            frame.pages.push_back(createPage(std::max(_page_size, aligned)));
+        }
+
+        const auto& page = frame.pages[frame.page];
+        const auto offset = std::exchange(frame.offset, frame.offset + aligned);
+        return UniformAllocation{page.handle, offset, size, page.pointer + offset};
+    }
+
+    template <typename T>
+    UniformAllocation push(const T& value) {
+        auto allocation = allocate(sizeof(T));
+        std::memcpy(allocation.pointer, &value, sizeof(T));
+        return allocation;
+    }
+
+private:
+    struct Page {
+        GLuint handle;
+        GLsizeiptr size;
+        std::byte* pointer;
+    };
+
+    struct Frame {
+        std::vector<Page> pages{};
+        size_t page = 0;
+        GLsizeiptr offset = 0;
+        uint64_t frame = UINT64_MAX;
+    };
+
+    Page createPage(GLsizeiptr size) {
+        static constexpr auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        Page page{GL_NONE, size, nullptr};
+        glCreateBuffers(1, &page.handle);
+        glNamedBufferStorage(page.handle, size, nullptr, flags);
+        page.pointer = static_cast<std::byte*>(glMapNamedBufferRange(page.handle, 0, size, flags));
+        _memory.track(GpuResource::Buffer, page.handle, GpuMemoryCategory::Uniform, static_cast<size_t>(size));
+        return page;
+    }
+
+    const FrameSync& _sync;
+    GpuMemoryRegistry& _memory;
+    GLsizeiptr _page_size;
+    GLsizeiptr _alignment = 256;
+    std::vector<Frame> _frames{};
+};
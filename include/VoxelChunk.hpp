@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <span>
+
+// RGBA colour of every voxel value; value 0 is air and never drawn.
+using VoxelPalette = std::array<glm::u8vec4, 256>;
+
+// Dense cube of 8-bit voxel values, x varies fastest, then z, then y.
+struct VoxelChunk {
+    static constexpr int SIZE = 32;
+    static constexpr size_t VOLUME = size_t(SIZE) * SIZE * SIZE;
+
+    VoxelChunk() : _voxels(VOLUME, 0) {}
+
+    static size_t index(int x, int y, int z) {
+        return (static_cast<size_t>(y) * SIZE + static_cast<size_t>(z)) * SIZE + static_cast<size_t>(x);
+    }
+
+    static bool contains(int x, int y, int z) {
+        return x >= 0 && y >= 0 && z >= 0 && x < SIZE && y < SIZE && z < SIZE;
+    }
+
+    // Out-of-range coordinates read as air.
+    uint8_t get(int x, int y, int z) const {
+        return contains(x, y, z) ? _voxels[index(x, y, z)] : 0;
+    }
+
+    void set(int x, int y, int z, uint8_t value) {
+        _voxels[index(x, y, z)] = value;
+    }
+
+    std::span<const uint8_t> voxels() const {
+        return _voxels;
+    }
+
+    std::span<uint8_t> voxels() {
+        return _voxels;
+    }
+
+private:
+    std::vector<uint8_t> _voxels;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <VoxelChunk.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <span>
+
+// Coarser copies of a VoxelChunk for level-of-detail meshing. Level n has (SIZE >> n)^3 cells, each
+// standing for a 2^n cube of voxels; level 0 is the chunk itself and is not copied. A cell is solid
+// when at least half of its eight children are, and takes the most common value among the solid ones,
+// which keeps surfaces within one cell of where the full resolution puts them.
+struct VoxelLodChain {
+    static constexpr int LEVELS = 4; /// 1x, 2x, 4x and 8x downsampled
+
+    VoxelLodChain() = default;
+
+    explicit VoxelLodChain(const VoxelChunk& chunk) {
+        rebuild(chunk);
+    }
+
+    void rebuild(const VoxelChunk& chunk) {
+        auto source = chunk.voxels();
+        for (int level = 1; level < LEVELS; ++level) {
+            auto& target = _levels[static_cast<size_t>(level - 1)];
+            target.resize(static_cast<size_t>(size(level)) * size(level) * size(level));
+            downsample(source, size(level - 1), target);
+            source = target;
+        }
+    }
+
+    static int size(int level) {
+        return VoxelChunk::SIZE >> level;
+    }
+
+    static float scale(int level) {
+        return static_cast<float>(1 << level);
+    }
+
+    // Expects rebuild() to have run for `chunk` if it was default constructed.
+    std::span<const uint8_t> voxels(const VoxelChunk& chunk, int level) const {
+        return level == 0 ? chunk.voxels() : std::span<const uint8_t>(_levels[static_cast<size_t>(level - 1)]);
+    }
+
+private:
+    static void downsample(std::span<const uint8_t> source, int source_size, std::vector<uint8_t>& target) {
+        const auto size = source_size / 2;
+        const auto at = [source, source_size](int x, int y, int z) {
+            return source[(static_cast<size_t>(y) * source_size + static_cast<size_t>(z)) * source_size + static_cast<size_t>(x)];
+        };
+
+        for (int y = 0; y < size; ++y) {
+            for (int z = 0; z < size; ++z) {
+                for (int x = 0; x < size; ++x) {
+                    std::array<uint8_t, 8> children{};
+                    size_t solid = 0;
+                    for (int i = 0; i < 8; ++i) {
+                        const auto value = at(x * 2 + (i & 1), y * 2 + ((i >> 1) & 1), z * 2 + (i >> 2));
+                        if (value != 0) {
+                            children[solid++] = value;
+                        }
+                    }
+
+                    uint8_t value = 0;
+                    if (solid >= 4) {
+                        std::sort(children.begin(), children.begin() + solid);
+                        size_t best = 0;
+                        for (size_t i = 0, run = 0; i < solid; ++i) {
+                            run = i > 0 && children[i] == children[i - 1] ? run + 1 : 1;
+                            if (run > best) {
+                                best = run;
+                                value = children[i];
+                            }
+                        }
+                    }
+                    target[(static_cast<size_t>(y) * size + static_cast<size_t>(z)) * size + static_cast<size_t>(x)] = value;
+                }
+            }
+        }
+    }
+
+    std::array<std::vector<uint8_t>, LEVELS - 1> _levels{};
+};
+
+// Picks the coarsest level whose geometric error, 2^level - 1 voxels, projects to at most
+// `max_error` pixels at the given distance. Moving to a coarser level additionally requires the error
+// to fall `hysteresis` below the limit, so chunks near a threshold do not flip back and forth.
+struct LodSelector {
+    float max_error = 8.0f;        /// pixels
+    float hysteresis = 0.25f;      /// fraction of max_error
+    float projection_scale = 1.0f; /// pixels per unit at distance 1: viewport height * projection[1][1] / 2
+
+    int select(float distance, int current) const {
+        auto level = 0;
+        for (int candidate = VoxelLodChain::LEVELS - 1; candidate > 0; --candidate) {
+            const auto limit = candidate > current ? max_error * (1.0f - hysteresis) : max_error;
+            if (screenError(candidate, distance) <= limit) {
+                level = candidate;
+                break;
+            }
+        }
+        return level;
+    }
+
+    float screenError(int level, float distance) const {
+        const auto error = static_cast<float>((1 << level) - 1);
+        return error * projection_scale / std::max(distance, 1e-3f);
+    }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <VoxelChunk.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <span>
+
+struct BlockVertex {
+    glm::vec3 pos;
+    glm::u8vec4 col;
+};
+
+// Face tables shared with the compute mesher in GpuVoxelMesher; corners wind counter-clockwise seen
+// from outside, matching BlockRenderContext::cube.
+namespace detail {
+    inline constexpr std::array<std::array<int, 3>, 6> FACE_NORMALS {{
+        {0, 0, -1}, {1, 0, 0}, {0, 0, 1}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}
+    }};
+
+    inline constexpr std::array<std::array<std::array<int, 3>, 4>, 6> FACE_CORNERS {{
+        {{{0, 0, 0}, {0, 1, 0}, {1, 1, 0}, {1, 0, 0}}},
+        {{{1, 0, 0}, {1, 1, 0}, {1, 1, 1}, {1, 0, 1}}},
+        {{{1, 0, 1}, {1, 1, 1}, {0, 1, 1}, {0, 0, 1}}},
+        {{{0, 0, 1}, {0, 1, 1}, {0, 1, 0}, {0, 0, 0}}},
+        {{{0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 1, 0}}},
+        {{{0, 0, 1}, {0, 0, 0}, {1, 0, 0}, {1, 0, 1}}},
+    }};
+
+    /// out of 255: sides, top and bottom get different brightness so the shape reads without lighting
+    inline constexpr std::array<uint32_t, 6> FACE_SHADE {204, 204, 204, 204, 255, 153};
+
+    inline glm::u8vec4 shade(const glm::u8vec4& color, uint32_t shade) {
+        return {
+            static_cast<uint8_t>((color.x * shade + 127) / 255),
+            static_cast<uint8_t>((color.y * shade + 127) / 255),
+            static_cast<uint8_t>((color.z * shade + 127) / 255),
+            color.w
+        };
+    }
+}
+
+// Emits one quad per voxel face that borders air, in chunk-local units (one voxel is 1.0). Voxels
+// outside the grid read as air, so faces along the chunk border are always emitted; they close the
+// chunk off and act as skirts where a neighbour is meshed at another level of detail.
+// Output vectors are cleared first; keep them around between calls to reuse their capacity.
+struct VoxelMesher {
+    static void mesh(const VoxelChunk& chunk, const VoxelPalette& palette, std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices) {
+        mesh(chunk.voxels(), VoxelChunk::SIZE, 1.0f, palette, vertices, indices);
+    }
+
+    // A `size`^3 grid laid out like VoxelChunk, each cell `scale` units wide; see VoxelLodChain.
+    static void mesh(std::span<const uint8_t> voxels, int size, float scale, const VoxelPalette& palette, std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices) {
+        vertices.clear();
+        indices.clear();
+
+        forEachFace(voxels, size, [&](int x, int y, int z, size_t face, uint8_t value) {
+            const auto base = static_cast<uint32_t>(vertices.size());
+            const auto color = detail::shade(palette[value], detail::FACE_SHADE[face]);
+            for (const auto& c : detail::FACE_CORNERS[face]) {
+                vertices.push_back(BlockVertex{glm::vec3(x + c[0], y + c[1], z + c[2]) * scale, color});
+            }
+            indices.insert(indices.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+        });
+    }
+
+    static size_t countFaces(std::span<const uint8_t> voxels, int size) {
+        size_t faces = 0;
+        forEachFace(voxels, size, [&faces](int, int, int, size_t, uint8_t) { faces += 1; });
+        return faces;
+    }
+
+private:
+    template <typename Fn>
+    static void forEachFace(std::span<const uint8_t> voxels, int size, Fn&& fn) {
+        const auto extent = static_cast<unsigned>(size);
+        const auto get = [voxels, extent](int x, int y, int z) -> uint8_t {
+            /// negative coordinates wrap to large unsigned values
+            if (static_cast<unsigned>(x) >= extent || static_cast<unsigned>(y) >= extent || static_cast<unsigned>(z) >= extent) {
+                return 0;
+            }
+            return voxels[(static_cast<size_t>(y) * extent + static_cast<size_t>(z)) * extent + static_cast<size_t>(x)];
+        };
+
+        for (int y = 0; y < size; ++y) {
+            for (int z = 0; z < size; ++z) {
+                for (int x = 0; x < size; ++x) {
+                    const auto value = get(x, y, z);
+                    if (value == 0) {
+                        continue;
+                    }
+                    for (size_t face = 0; face < 6; ++face) {
+                        const auto& n = detail::FACE_NORMALS[face];
+                        if (get(x + n[0], y + n[1], z + n[2]) == 0) {
+                            fn(x, y, z, face, value);
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
@@ -4,7 +4,7 @@
 #include <glm/glm.hpp>
 #include <Event.hpp>
 #include <optional>
-#include <queue>
+#include <vector>
 
 struct Window {
     Window(const char* title, int width, int height) : _size(width, height) {
@@ -16,7 +16,6 @@ struct Window {
 
         _window = glfwCreateWindow(width, height, title, nullptr, nullptr);
         glfwMakeContextCurrent(_window);
-        glfwSwapInterval(1);
 
         glfwSetWindowUserPointer(_window, this);
 
@@ -57,10 +56,18 @@ struct Window {
             self->pushEvent(WindowCloseEvent{});
         });
 
+        glfwSetWindowRefreshCallback(_window, [](GLFWwindow* window) {
+            auto self = static_cast<Window*>(glfwGetWindowUserPointer(window));
+            self->pushEvent(WindowRefreshEvent{});
+        });
+
 //        pushEvent(WindowResizeEvent{width, height});
     }
 
     ~Window() {
+        for (auto context : _sharedContexts) {
+            glfwDestroyWindow(context);
+        }
         glfwDestroyWindow(_window);
         glfwTerminate();
     }
@@ -75,34 +82,70 @@ struct Window {
         return size;
     }
 
+    // Hidden context that shares objects with the window's, for a worker thread to make current. Must
+    // be called on the main thread; it lives as long as the window.
+    GLFWwindow* createSharedContext() {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        auto context = glfwCreateWindow(1, 1, "", nullptr, _window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (context != nullptr) {
+            _sharedContexts.push_back(context);
+        }
+        return context;
+    }
+
     bool shouldClose() const {
         return glfwWindowShouldClose(_window);
     }
 
     void pushEvent(const Event& event) {
-        _events.push(event);
+        _events.push_back(event);
+    }
+
+    void setSwapInterval(int interval) {
+        glfwSwapInterval(interval);
+    }
+
+    // Whether a negative swap interval (late swaps tear instead of waiting for the next vblank) is available.
+    bool supportsAdaptiveSync() const {
+        return glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
     }
 
     void swapBuffers() {
         glfwSwapBuffers(_window);
     }
 
+    // Blocks until an event arrives, wakeUp() is called or `timeout` seconds pass. The events are
+    // delivered by the next pumpEvents().
+    void waitEvents(double timeout) {
+        glfwWaitEventsTimeout(timeout);
+    }
+
+    // Interrupts waitEvents(); safe to call from any thread.
+    void wakeUp() {
+        glfwPostEmptyEvent();
+    }
+
     void pumpEvents() {
         glfwPollEvents();
-        _frameEvents = std::exchange(_events, std::queue<Event>{});
+        /// double-buffered, both vectors keep their capacity so a steady-state frame doesn't allocate
+        _frameEvents.clear();
+        std::swap(_events, _frameEvents);
+        _frameCursor = 0;
     }
 
     std::optional<Event> pollEvent() {
-        if (_frameEvents.empty()) {
+        if (_frameCursor == _frameEvents.size()) {
             return std::nullopt;
         }
-        auto event = _frameEvents.front();
-        return _frameEvents.pop(), event;
+        return _frameEvents[_frameCursor++];
     }
 
 private:
     GLFWwindow* _window;
+    std::vector<GLFWwindow*> _sharedContexts{};
     glm::ivec2 _size;
-    std::queue<Event> _events{};
-    std::queue<Event> _frameEvents{};
+    std::vector<Event> _events{};
+    std::vector<Event> _frameEvents{};
+    size_t _frameCursor = 0;
 };
\ No newline at end of file
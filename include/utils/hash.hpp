@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <span>
+
+// XXH64 (https://github.com/Cyan4973/xxHash), used for content hashes of images, meshes and UI streams.
+struct Hash64 {
+    static uint64_t compute(const void* input, size_t size, uint64_t seed = 0) {
+        auto p = static_cast<const uint8_t*>(input);
+        const auto end = p + size;
+        uint64_t h;
+
+        if (size >= 32) {
+            uint64_t v1 = seed + PRIME1 + PRIME2;
+            uint64_t v2 = seed + PRIME2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - PRIME1;
+            do {
+                v1 = round(v1, read64(p + 0));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+                p += 32;
+            } while (p + 32 <= end);
+
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge(h, v1);
+            h = merge(h, v2);
+            h = merge(h, v3);
+            h = merge(h, v4);
+        } else {
+            h = seed + PRIME5;
+        }
+
+        h += static_cast<uint64_t>(size);
+
+        while (p + 8 <= end) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * PRIME1 + PRIME4;
+            p += 8;
+        }
+        if (p + 4 <= end) {
+            h ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+            h = rotl(h, 23) * PRIME2 + PRIME3;
+            p += 4;
+        }
+        while (p < end) {
+            h ^= static_cast<uint64_t>(*p) * PRIME5;
+            h = rotl(h, 11) * PRIME1;
+            p += 1;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    template <typename T, size_t Extent>
+    static uint64_t compute(std::span<T, Extent> data, uint64_t seed = 0) {
+        return compute(data.data(), data.size_bytes(), seed);
+    }
+
+    // Order-dependent combination of two hashes.
+    static uint64_t combine(uint64_t seed, uint64_t value) {
+        return seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+    }
+
+private:
+    static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+    static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+    static constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+    static constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+    static constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+    static uint64_t rotl(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static uint64_t read64(const uint8_t* p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint32_t read32(const uint8_t* p) {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * PRIME2;
+        acc = rotl(acc, 31);
+        return acc * PRIME1;
+    }
+
+    static uint64_t merge(uint64_t acc, uint64_t val) {
+        acc ^= round(0, val);
+        return acc * PRIME1 + PRIME4;
+    }
+};
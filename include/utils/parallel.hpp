@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Non-owning reference to a callable taking an index. Unlike std::function it never allocates; the
+// callable has to outlive the call it is passed to.
+struct IndexFnRef {
+    template <typename Fn> requires (!std::is_same_v<std::remove_const_t<Fn>, IndexFnRef>)
+    IndexFnRef(Fn& fn) : _object(std::addressof(fn)), _call([](const void* object, size_t i) { (*static_cast<Fn*>(const_cast<void*>(object)))(i); }) {}
+
+    void operator()(size_t i) const {
+        _call(_object, i);
+    }
+
+private:
+    const void* _object;
+    void (*_call)(const void*, size_t);
+};
+
+// Small persistent worker pool. One job runs at a time and the calling thread takes part in it.
+// parallelFor calls made from inside a job, on a worker or on the calling thread, run inline, so
+// nesting never waits on the pool; calls from other threads wait for the running job to finish.
+struct ThreadPool {
+    static ThreadPool& instance() {
+        static ThreadPool pool{std::max(1u, std::thread::hardware_concurrency()) - 1};
+        return pool;
+    }
+
+    explicit ThreadPool(size_t count) {
+        _workers.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            _workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock{_mutex};
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto& worker : _workers) {
+            worker.join();
+        }
+    }
+
+    size_t concurrency() const {
+        return _workers.size() + 1;
+    }
+
+    // Calls fn() with every parallelFor it makes running inline on the calling thread, for timing
+    // the serial path of code that is otherwise split across the pool.
+    template <typename Fn>
+    static void serial(Fn&& fn) {
+        const auto inside = std::exchange(_insideJob, true);
+        fn();
+        _insideJob = inside;
+    }
+
+    void parallelFor(size_t count, IndexFnRef fn) {
+        if (count == 0) {
+            return;
+        }
+        if (count == 1 || _workers.empty() || _insideJob) {
+            for (size_t i = 0; i < count; ++i) {
+                fn(i);
+            }
+            return;
+        }
+
+        std::lock_guard submit{_submit};
+        {
+            std::lock_guard lock{_mutex};
+            _job = &fn;
+            _count = count;
+            _next.store(0, std::memory_order_relaxed);
+            _pending.store(count, std::memory_order_relaxed);
+            _generation += 1;
+        }
+        _wake.notify_all();
+
+        _insideJob = true;
+        runItems();
+        _insideJob = false;
+
+        std::unique_lock lock{_mutex};
+        _done.wait(lock, [this] { return _pending.load(std::memory_order_acquire) == 0 && _active == 0; });
+        _job = nullptr;
+    }
+
+private:
+    void workerLoop() {
+        _insideJob = true;
+
+        size_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock lock{_mutex};
+                _wake.wait(lock, [&] { return _stop || (_job != nullptr && _generation != seen); });
+                if (_stop) {
+                    return;
+                }
+                seen = _generation;
+                _active += 1;
+            }
+
+            runItems();
+
+            std::lock_guard lock{_mutex};
+            _active -= 1;
+            if (_active == 0 && _pending.load(std::memory_order_acquire) == 0) {
+                _done.notify_all();
+            }
+        }
+    }
+
+    void runItems() {
+        const auto fn = *_job;
+        for (size_t i = _next.fetch_add(1, std::memory_order_relaxed); i < _count; i = _next.fetch_add(1, std::memory_order_relaxed)) {
+            fn(i);
+            _pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    std::vector<std::thread> _workers{};
+    std::mutex _submit{};
+    std::mutex _mutex{};
+    std::condition_variable _wake{};
+    std::condition_variable _done{};
+
+    const IndexFnRef* _job = nullptr;
+    size_t _count = 0;
+    size_t _generation = 0;
+    size_t _active = 0;
+    bool _stop = false;
+    std::atomic_size_t _next{0};
+    std::atomic_size_t _pending{0};
+
+    static inline thread_local bool _insideJob = false;
+};
+
+// Runs fn(i) for every i in [0, count) on the shared pool and returns once all of them finished.
+template <typename Fn>
+inline void parallelFor(size_t count, Fn&& fn) {
+    ThreadPool::instance().parallelFor(count, IndexFnRef(fn));
+}
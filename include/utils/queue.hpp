@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread. The capacity is
+// rounded up to a power of two; push() fails instead of blocking when the queue is full.
+template <typename T>
+struct SpscQueue {
+    explicit SpscQueue(size_t capacity) : _slots(std::bit_ceil(std::max<size_t>(capacity, 2))), _mask(_slots.size() - 1) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer only.
+    bool push(T&& value) {
+        const auto tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head_cache == _slots.size()) {
+            _head_cache = _head.load(std::memory_order_acquire);
+            if (tail - _head_cache == _slots.size()) {
+                return false;
+            }
+        }
+        _slots[tail & _mask] = std::move(value);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only.
+    std::optional<T> pop() {
+        const auto head = _head.load(std::memory_order_relaxed);
+        if (head == _tail_cache) {
+            _tail_cache = _tail.load(std::memory_order_acquire);
+            if (head == _tail_cache) {
+                return std::nullopt;
+            }
+        }
+        auto value = std::move(_slots[head & _mask]);
+        _slots[head & _mask] = T{}; /// release what the slot owned now rather than when it is reused
+        _head.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    // Either side; exact only while the other side is idle.
+    bool empty() const {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    /// fixed instead of std::hardware_destructive_interference_size, which warns when used in headers
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::vector<T> _slots;
+    size_t _mask;
+
+    /// each side's index on its own line, next to its cached copy of the other side's
+    alignas(CACHE_LINE) std::atomic<size_t> _head{0};
+    size_t _tail_cache = 0;
+    alignas(CACHE_LINE) std::atomic<size_t> _tail{0};
+    size_t _head_cache = 0;
+};
@@ -3,75 +3,50 @@
 #include <Application.hpp>
 #include <AppPlatform.hpp>
 #include <ImGuiLayer.hpp>
+#include <TextureManager.hpp>
+#include <TextureAtlas.hpp>
+#include <UniformAllocator.hpp>
 #include <Camera.hpp>
-#include <Mesh.hpp>
+#include <MeshHeap.hpp>
+#include <TransformStore.hpp>
+#include <Ecs.hpp>
+#include <RenderQueue.hpp>
+#include <OcclusionCuller.hpp>
+#include <GpuCuller.hpp>
+#include <GpuVoxelMesher.hpp>
+#include <VoxelLod.hpp>
+#include <PalettedChunk.hpp>
+#include <ChunkResidency.hpp>
+#include <MeshCache.hpp>
+#include <AsyncUploader.hpp>
+#include <ImageExport.hpp>
+#include <unordered_map>
+#include <optional>
+#include <cassert>
+#include <cstdlib>
+#include <memory_resource>
 #include <memory>
+#include <vector>
 #include <array>
 
-struct Transform {
-    glm::vec2 rotation{};
-    glm::vec3 position{};
-
-    auto getRotationMatrix() const -> glm::mat4 {
-        return getRotationMatrix(rotation);
-    }
-
-    auto getTransformMatrix() const -> glm::mat4 {
-        return glm::translate(getRotationMatrix(), -position);
-    }
-
-    auto getTransformMatrix(glm::vec3 offset) const -> glm::mat4 {
-        return glm::translate(getRotationMatrix(), -(position + offset));
-    }
-
-    auto up() const -> glm::vec3 {
-        return glm::vec3(0, 1, 0) * glm::mat3(getRotationMatrix());
-    }
-
-    auto forward() const -> glm::vec3 {
-        return glm::vec3(0, 0, 1) * glm::mat3(getRotationMatrix());
-    }
-
-    auto right() const -> glm::vec3 {
-        return glm::vec3(1, 0, 0) * glm::mat3(getRotationMatrix());
-    }
-
-    static auto getRotationMatrix(const glm::vec2& rotation) -> glm::mat4 {
-        const auto ry = glm::radians(rotation.x);
-        const auto rp = glm::radians(rotation.y);
-
-        const auto [sy, cy] = std::pair{ glm::sin(ry), glm::cos(ry) };
-        const auto [sp, cp] = std::pair{ glm::sin(rp), glm::cos(rp) };
-
-        return {
-            cy, sp * sy, -cp * sy, 0,
-            0, cp, sp, 0,
-            sy, -sp * cy, cp * cy, 0,
-            0, 0, 0, 1
-        };
-    }
-};
-
 struct CameraConstants {
     glm::mat4 transform;
     glm::vec4 position;
 };
 
-struct CameraUniform {
-    GLuint handle;
-    void* pointer;
-};
-
-struct BlockVertex {
-    glm::vec3 pos;
-    glm::u8vec4 col;
+struct ObjectConstants {
+    glm::mat4 transform;
 };
 
 struct BlockRenderContext {
-    std::vector<glm::i32> _indices{};
-    std::vector<BlockVertex> _vertices{};
+    std::pmr::vector<glm::u32> _indices;
+    std::pmr::vector<BlockVertex> _vertices;
 
-    std::span<const glm::i32> indices() const {
+    explicit BlockRenderContext(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : _indices(resource)
+        , _vertices(resource) {}
+
+    std::span<const glm::u32> indices() const {
         return _indices;
     }
 
@@ -143,27 +118,208 @@ struct BlockRenderContext {
     }
 };
 
+// Degrees per second around (yaw, pitch), applied to Orientation by the spin system.
+struct Spin {
+    glm::vec2 rate;
+};
+
+struct Orientation {
+    glm::vec2 rotation;
+};
+
+// Row in App::objects that holds the entity's world and MVP matrices.
+struct ObjectSlot {
+    uint32_t index;
+};
+
+struct Renderable {
+    MeshHandle mesh;
+};
+
+// Chunk meshed by GpuVoxelMesher; drawn instead of its Renderable while App::gpu_meshing is set.
+struct GpuMeshed {
+    GpuChunkMesh mesh;
+};
+
+// Level of detail a chunk's Renderable is meshed at, -1 while it has none; `desired` is chosen by the
+// LOD system and App::MeshChunks rebuilds the mesh to match.
+struct ChunkLod {
+    int level = -1;
+    int desired = 0;
+    size_t faces = 0;
+    size_t full_faces = 0; /// at level 0, for the overlay
+};
+
+// Chunk whose new mesh is on its way through App::uploader; it is not rebuilt until that arrives.
+struct ChunkUpload {
+    uint64_t id;
+};
+
+// Object-space box, tested for frustum and occlusion culling before a Renderable is drawn.
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Mesh in an AsyncUploader staging buffer: vertices first, then indices.
+struct PendingChunkUpload {
+    Entity entity;
+    int level;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    size_t bytes; /// reserved in App::residency until the upload arrives or is cancelled
+};
+
+// Random reads and whole-chunk decodes of PalettedChunk against a flat 16-bit array on a generated
+// chunk, run from the benchmark panel.
+struct VoxelStorageBenchmark {
+    double packed_get_ns = 0.0;
+    double flat_get_ns = 0.0;
+    double unpack_us = 0.0;
+    double flat_copy_us = 0.0;
+    size_t checksum = 0; /// keeps the reads from being optimised out
+};
+
+// TransformStore::update() against building every world and MVP matrix from a Transform-style
+// position, rotation and scale, with all objects changed between updates.
+struct TransformBenchmark {
+    size_t objects = 0;
+    double store_ms = 0.0;
+    double scalar_ms = 0.0;
+    float max_mvp_error = 0.0f;
+    float max_sincos_error = 0.0f; /// of the SSE sincos against std::sin/std::cos, 0 without SSE2
+};
+
+// Encoding throughput of a generated image in MB/s of raw RGBA, with the strip-parallel encoders
+// once forced onto one thread and once split across the pool. QOI has no strips, so both are serial.
+struct ImageExportBenchmark {
+    struct Encoder {
+        const char* name;
+        double serial_mbps;
+        double strips_mbps;
+        size_t bytes; /// encoded size
+    };
+
+    glm::u32 width = 0;
+    glm::u32 height = 0;
+    std::array<Encoder, 3> encoders{};
+};
+
+// Work done by App::StreamChunks during the last frame.
+struct StreamingStats {
+    size_t loads = 0;
+    size_t unloads = 0;
+    size_t uploads = 0;
+    size_t evictions = 0;
+    size_t cache_hits = 0;
+};
+
+// Chunk meshed on a worker thread, or mapped from the mesh cache, waiting for its upload.
+struct ChunkBuild {
+    Entity entity{};
+    int level = 0;
+    VoxelChunk voxels{}; /// the entity's PalettedChunk, unpacked for level 0
+    std::vector<BlockVertex> vertices{};
+    std::vector<uint32_t> indices{};
+    std::optional<MappedMesh> cached{};
+
+    std::span<const BlockVertex> meshVertices() const {
+        return cached ? cached->vertices<BlockVertex>() : std::span<const BlockVertex>(vertices);
+    }
+
+    std::span<const uint32_t> meshIndices() const {
+        return cached ? cached->indices : std::span<const uint32_t>(indices);
+    }
+};
+
 struct App : Application<App> {
     std::unique_ptr<ImGuiLayer> imgui{};
+    std::unique_ptr<TextureManager> textures{};
+    std::unique_ptr<TextureAtlas> atlas{};
     std::vector<std::unique_ptr<RenderTarget>> frames{};
-    int frameIndex = 0;
 
     /*****************************************************************************************************************/
 
     Input input{};
     Camera camera{};
     Viewport viewport{};
-    Transform transform{};
-    std::vector<CameraUniform> uniforms{};
+    Registry registry{};
+    Scheduler scheduler{registry};
+    Entity camera_entity{};
+    TransformStore objects{};
+    std::unique_ptr<UniformAllocator> uniforms{};
 
     GLuint shader_handle;
-
-    std::unique_ptr<Mesh> block_mesh;
+    GLuint culled_shader_handle;
+
+    std::unique_ptr<MeshHeap> block_meshes;
+    RenderQueue queue{};
+    std::unique_ptr<OcclusionCuller> occlusion{};
+    std::unique_ptr<GpuCuller> gpu_culler{};
+    bool gpu_culling = false;
+
+    static constexpr size_t LOADS_PER_FRAME = 8;   /// chunks generated per frame at most
+    static constexpr size_t UPLOADS_PER_FRAME = 8; /// chunk meshes built and uploaded per frame at most
+    static constexpr glm::u32 SWATCH_SIZE = 16;    /// texels per side of a palette swatch
+
+    /// bump when the output of BlockRenderContext or VoxelMesher changes, to invalidate cached meshes
+    static constexpr uint64_t MESH_VERSION = 1;
+    static constexpr std::array<std::array<float, 6>, 11> BLOCK_CUBES {{
+        {0, 0, 4, 16, 1, 12},
+        {1, 0, 3, 15, 1, 4},
+        {1, 0, 12, 15, 1, 13},
+        {1, 1, 4, 15, 4, 12},
+        {4, 4, 5, 12, 5, 12},
+        {6, 5, 5, 10, 10, 12},
+        {2, 10, 4, 14, 16, 12},
+        {14, 11, 4, 16, 15, 12},
+        {0, 11, 4, 2, 15, 12},
+        {3, 11, 3, 13, 15, 4},
+        {3, 11, 12, 13, 15, 13},
+    }};
+
+    std::array<VertexArrayAttrib, 2> block_attributes{};
+    MeshCache mesh_cache{std::filesystem::path("cache") / "meshes"};
+    bool use_mesh_cache = true;
+    uint64_t chunk_mesh_seed = 0; /// palette and MESH_VERSION, mixed into every chunk mesh key
+
+    VoxelPalette palette{};
+    std::vector<AtlasRegion> swatches{}; /// one atlas image per palette entry, drawn in the palette panel
+    ChunkResidency residency{glm::vec2(-16.0f, -24.0f), static_cast<float>(VoxelChunk::SIZE)};
+    std::unordered_map<ChunkCoord, Entity, ChunkCoordHash> chunks{};
+    std::vector<ChunkCoord> chunk_loads{};
+    std::vector<ChunkCoord> chunk_unloads{};
+    std::vector<std::pair<float, Entity>> chunk_candidates{};
+    std::vector<ChunkBuild> chunk_builds{};
+    std::unique_ptr<AsyncUploader> uploader{};
+    std::unordered_map<uint64_t, PendingChunkUpload> chunk_uploads{};
+    bool async_uploads = false;
+    float gpu_budget_mib = 512.0f; /// GpuMemoryRegistry budget, 0 for none
+    StreamingStats streaming{};
+    bool fly = false;
+    float fly_speed = 100.0f; /// units per second
+    Entity chunk_entity{}; /// the chunk at the origin, also meshed by voxel_mesher while loaded
+    std::unique_ptr<GpuVoxelMesher> voxel_mesher{};
+    ChunkBuild chunk_build{};
+    std::optional<VoxelStorageBenchmark> storage_benchmark{};
+    std::optional<TransformBenchmark> transform_benchmark{};
+    std::optional<ImageExportBenchmark> export_benchmark{};
+    LodSelector lod_selector{};
+    std::array<size_t, VoxelLodChain::LEVELS> lod_chunks{};
+    size_t lod_faces = 0;
+    size_t lod_full_faces = 0;
+    double cpu_mesh_time = 0.0;
+    size_t cpu_mesh_faces = 0;
+    bool gpu_meshing = false;
+    bool remesh_every_frame = false;
 
     App(const char* title, int width, int height) : Application{title, width, height} {
         imgui = std::make_unique<ImGuiLayer>(*renderContext);
+        textures = std::make_unique<TextureManager>(*renderContext);
+        atlas = std::make_unique<TextureAtlas>(*renderContext, 512);
 
-        CreateUniforms();
+        uniforms = std::make_unique<UniformAllocator>(*renderContext);
+        occlusion = std::make_unique<OcclusionCuller>(*renderContext);
         CreateRenderTargets(width, height);
 
         auto vertex_source = AppPlatform::readFile("assets/default.vert").value();
@@ -171,32 +327,75 @@ struct App : Application<App> {
 
         shader_handle = renderContext->createShader(vertex_source, fragment_source);
 
-        const std::array attributes {
+        auto culled_vertex_source = AppPlatform::readFile("assets/culled.vert").value();
+        culled_shader_handle = renderContext->createShader(culled_vertex_source, fragment_source);
+
+        block_attributes = {
             VertexArrayAttrib{0, 3, GL_FLOAT, GL_FALSE, static_cast<GLuint>(offsetof(BlockVertex, pos))},
             VertexArrayAttrib{1, 4, GL_UNSIGNED_BYTE, GL_TRUE, static_cast<GLuint>(offsetof(BlockVertex, col))},
         };
+        const auto& attributes = block_attributes;
 
         const std::array bindings {
             VertexArrayBinding{0, 0},
             VertexArrayBinding{1, 0}
         };
 
-        BlockRenderContext ctx{};
-        ctx.cube({}, 0, 0, 4, 16, 1, 12);
-        ctx.cube({}, 1, 0, 3, 15, 1, 4);
-        ctx.cube({}, 1, 0, 12, 15, 1, 13);
-        ctx.cube({}, 1, 1, 4, 15, 4, 12);
-        ctx.cube({}, 4, 4, 5, 12, 5, 12);
-        ctx.cube({}, 6, 5, 5, 10, 10, 12);
-        ctx.cube({}, 2, 10, 4, 14, 16, 12);
-        ctx.cube({}, 14, 11, 4, 16, 15, 12);
-        ctx.cube({}, 0, 11, 4, 2, 15, 12);
-        ctx.cube({}, 3, 11, 3, 13, 15, 4);
-        ctx.cube({}, 3, 11, 12, 13, 15, 13);
 
-        block_mesh = std::make_unique<Mesh>(attributes, bindings, sizeof(BlockVertex), GL_STATIC_DRAW);
-        block_mesh->SetIndices(ctx.indices());
-        block_mesh->SetVertices(ctx.vertices());
+        block_meshes = std::make_unique<MeshHeap>(*renderContext, attributes, bindings, sizeof(BlockVertex));
+        if (const auto context = window->createSharedContext()) {
+            uploader = std::make_unique<AsyncUploader>(renderContext->memory, context);
+            async_uploads = true;
+        }
+        renderContext->memory.setBudget(static_cast<size_t>(gpu_budget_mib) << 20);
+        renderContext->memory.addEvictionCallback([this](size_t excess) {
+            return EvictChunksOverBudget(excess);
+        });
+        gpu_culler = std::make_unique<GpuCuller>(*renderContext);
+        gpu_culler->attach(block_meshes->vao(), 2, 1);
+
+        camera_entity = registry.create();
+        auto& eye = registry.emplace<Transform>(camera_entity);
+        eye.rotation.y = 10;
+        eye.position.y = 2;
+        eye.position.z = 10;
+
+        const auto block = registry.create();
+        registry.emplace<Renderable>(block, CreateBlockMesh());
+        registry.emplace<ObjectSlot>(block, objects.add());
+        registry.emplace<Bounds>(block, glm::vec3(-0.5f), glm::vec3(0.5f));
+        registry.emplace<Orientation>(block, glm::vec2{0, 0});
+        registry.emplace<Spin>(block, glm::vec2{50, 0});
+
+        voxel_mesher = std::make_unique<GpuVoxelMesher>(*renderContext, attributes, bindings);
+        GeneratePalette();
+
+
+        scheduler.add(Reads<Spin>{}, Writes<Orientation>{}, [](Registry& world, float dt) {
+            world.parallelEach<Spin, Orientation>([dt](Entity, const Spin& spin, Orientation& orientation) {
+                orientation.rotation += spin.rate * dt;
+            });
+        });
+        /// rows of `objects` are owned by ObjectSlot, so writing them counts as writing ObjectSlot
+        scheduler.add(Reads<Orientation>{}, Writes<ObjectSlot>{}, [this](Registry& world, float) {
+            world.parallelEach<Orientation, ObjectSlot>([this](Entity, const Orientation& orientation, const ObjectSlot& slot) {
+                objects.setRotation(slot.index, orientation.rotation);
+            });
+        });
+        scheduler.add(Reads<Transform, ObjectSlot, Bounds>{}, Writes<ChunkLod>{}, [this](Registry& world, float) {
+            const auto eye = world.get<Transform>(camera_entity).position;
+            world.parallelEach<ObjectSlot, Bounds, ChunkLod>([this, eye](Entity, const ObjectSlot& slot, const Bounds& bounds, ChunkLod& lod) {
+                const auto origin = objects.position(slot.index);
+                const auto nearest = glm::clamp(eye, origin + bounds.min, origin + bounds.max);
+                lod.desired = lod_selector.select(glm::length(nearest - eye), lod.level);
+            });
+        });
+    }
+
+    ~App() {
+        if (registry.alive(chunk_entity)) {
+            voxel_mesher->destroy(registry.get<GpuMeshed>(chunk_entity).mesh);
+        }
     }
 
     void handleEvent(const Event& event) {
@@ -228,6 +427,24 @@ struct App : Application<App> {
         io.DisplaySize.y = static_cast<float>(viewport.height);
         io.DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
         io.DeltaTime = dt;
+
+        if (fly) {
+            auto& eye = registry.get<Transform>(camera_entity);
+            auto direction = -eye.forward();
+            direction.y = 0.0f;
+            if (glm::length(direction) > 1e-4f) {
+                eye.position += glm::normalize(direction) * fly_speed * dt;
+            }
+            requestRedraw();
+        }
+
+        streaming = {};
+        StreamChunks();
+        ReceiveChunkUploads();
+
+        lod_selector.projection_scale = camera.getProjection()[1][1] * static_cast<float>(viewport.height) * 0.5f;
+        scheduler.run(dt);
+        MeshChunks();
     }
 
     void renderFrame(float dt) {
@@ -235,38 +452,88 @@ struct App : Application<App> {
             return;
         }
 
-        transform.rotation.y = 10;
-        transform.position.y = 2;
-        transform.position.z = 10;
+        textures->update();
 
         auto renderTarget = BeginFrame(glm::vec4{ 0.45f, 0.55f, 0.60f, 1.00f });
         auto& io = imgui->begin();
         ImGui::SetNextWindowPos(ImVec2(0, 0));
         ImGui::Begin("MainWindow", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoBackground | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoCollapse);
-        ImGui::TextUnformatted(fmt::format("Application average {:.3f} ms/target ({:.3f} FPS)", 1000.0f / io.Framerate, io.Framerate).c_str());
+        ImGui::TextUnformatted(frameArena->format("Application average {:.3f} ms/target ({:.3f} FPS)", 1000.0f / io.Framerate, io.Framerate).data());
+        ImGui::TextUnformatted(frameArena->format("GPU wait {:.3f} ms ({} frames in flight)", renderContext->frameSync.waitTime().count(), renderContext->frameSync.depth()).data());
+        const auto pacing = pacer->stats();
+        ImGui::TextUnformatted(frameArena->format("Frame time {:.3f} ms, stddev {:.3f} ms, range {:.3f}..{:.3f} ms", pacing.mean, pacing.stddev, pacing.min, pacing.max).data());
+        const auto& draws = queue.stats();
+        ImGui::TextUnformatted(frameArena->format("Draws {} (sort {:.3f} ms), state changes: {} programs, {} VAOs, {} textures", draws.commands, draws.sort_ms, draws.program_changes, draws.vao_changes, draws.texture_changes).data());
+        ImGui::Checkbox("GPU culling", &gpu_culling);
+        ImGui::Checkbox("GPU meshing", &gpu_meshing);
+        ImGui::Checkbox("Remesh every frame", &remesh_every_frame);
+        ImGui::TextUnformatted(frameArena->format("Chunk mesh: CPU {:.3f} ms ({} faces, incl. upload), GPU {:.3f} ms", cpu_mesh_time, cpu_mesh_faces, voxel_mesher->gpuTime()).data());
+        ImGui::SliderFloat("LOD error (px)", &lod_selector.max_error, 0.5f, 32.0f);
+        ImGui::Checkbox("Fly", &fly);
+        ImGui::SliderFloat("Fly speed", &fly_speed, 10.0f, 1000.0f);
+        ImGui::TextUnformatted(frameArena->format("Chunks {} loaded, {} queued, {} meshed in {:.1f} of {} MiB", residency.loaded(), residency.queued(), residency.meshed(), static_cast<double>(residency.meshBytes() + residency.reservedBytes()) / static_cast<double>(1 << 20), residency.mesh_budget >> 20).data());
+        ImGui::Checkbox("Mesh cache", &use_mesh_cache);
+        ImGui::SameLine();
+        ImGui::TextUnformatted(frameArena->format("({:.1f} MiB on disk)", static_cast<double>(mesh_cache.bytes()) / static_cast<double>(1 << 20)).data());
+        if (uploader) {
+            ImGui::Checkbox("Async uploads", &async_uploads);
+            ImGui::SameLine();
+            ImGui::TextUnformatted(frameArena->format("({} in flight)", uploader->pending()).data());
+        }
+        ImGui::TextUnformatted(frameArena->format("Streaming {} loads, {} unloads, {} uploads ({} from the mesh cache), {} evictions", streaming.loads, streaming.unloads, streaming.uploads, streaming.cache_hits, streaming.evictions).data());
+        size_t voxel_bytes = 0;
+        size_t voxel_chunks = 0;
+        registry.each<PalettedChunk>([&](Entity, const PalettedChunk& packed) {
+            voxel_bytes += packed.bytes();
+            voxel_chunks += 1;
+        });
+        ImGui::TextUnformatted(frameArena->format("Voxels {} KiB paletted vs {} KiB as uint16_t", voxel_bytes / 1024, voxel_chunks * VoxelChunk::VOLUME * sizeof(uint16_t) / 1024).data());
+        ImGui::TextUnformatted(frameArena->format("LOD chunks {}/{}/{}/{}, {} triangles drawn vs {} at full detail", lod_chunks[0], lod_chunks[1], lod_chunks[2], lod_chunks[3], lod_faces * 2, lod_full_faces * 2).data());
+        if (gpu_culling) {
+            const auto& culling = gpu_culler->stats();
+            ImGui::TextUnformatted(frameArena->format("Objects {} drawn of {} ({})", culling.drawn, culling.submitted, gpu_culler->indirectCount() ? "indirect count" : "zero-count fallback").data());
+        } else {
+            const auto& culling = occlusion->stats();
+            ImGui::TextUnformatted(frameArena->format("Objects {} drawn, {} frustum culled, {} occluded", culling.visible, culling.frustum_culled, culling.occlusion_culled).data());
+        }
+        if constexpr (AllocationTracker::enabled) {
+            ImGui::TextUnformatted(frameArena->format("Heap {} allocations/frame, {} KiB live", frameAllocations.allocations, AllocationTracker::total().liveBytes() / 1024).data());
+        }
         ImGui::End();
 
+        DrawGpuMemoryPanel();
+        DrawBenchmarkPanel();
+        DrawPalettePanel();
+
         imgui->end();
         imgui->flush();
 
+        if (imgui->animating() || textures->pending() > 0) {
+            requestRedraw();
+        }
+
         glEnable(GL_CULL_FACE);
         glEnable(GL_DEPTH_TEST);
 
         glDepthFunc(GL_GREATER);
         glDisable(GL_BLEND);
 
-        static float angle = 0;
-        const auto rotation_matrix = Transform::getRotationMatrix({angle, 0});
-        angle += dt * 50.0f;
+        if (remesh_every_frame && registry.alive(chunk_entity)) {
+            RemeshChunk();
+            requestRedraw();
+        }
 
-        SetupCamera();
+        const auto view_projection = SetupCamera();
+        objects.update(view_projection);
+        occlusion->begin(view_projection);
 
-        glUseProgram(shader_handle);
-        glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(rotation_matrix));
-        glBindVertexArray(block_mesh->vao);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(block_mesh->index_count), GL_UNSIGNED_INT, nullptr);
-        glBindVertexArray(0);
-        glUseProgram(0);
+        if (gpu_culling) {
+            RenderCulledOnGpu();
+        } else {
+            RenderCulledOnCpu();
+        }
+
+        occlusion->build(*renderTarget, view_projection);
 
         EndFrame();
 
@@ -274,22 +541,720 @@ struct App : Application<App> {
     }
 
 private:
-    void SetupCamera() {
+    void RenderCulledOnCpu() {
+        lod_chunks = {};
+        lod_faces = 0;
+        lod_full_faces = 0;
+
+        const auto eye = registry.get<Transform>(camera_entity).position;
+        registry.each<ObjectSlot, Renderable, Bounds>([&](Entity entity, const ObjectSlot& slot, const Renderable& renderable, const Bounds& bounds) {
+            if (gpu_meshing && registry.has<GpuMeshed>(entity)) {
+                return;
+            }
+            if (!occlusion->visible(objects.world()[slot.index], bounds.min, bounds.max)) {
+                return;
+            }
+            if (registry.has<ChunkLod>(entity)) {
+                const auto& lod = registry.get<ChunkLod>(entity);
+                lod_chunks[static_cast<size_t>(lod.level)] += 1;
+                lod_faces += lod.faces;
+                lod_full_faces += lod.full_faces;
+            }
+            const DrawCommand command {
+                .program = shader_handle,
+                .vao = block_meshes->vao(),
+                .range = block_meshes->range(renderable.mesh),
+                .uniforms = uniforms->push(ObjectConstants{.transform = objects.world()[slot.index]})
+            };
+            queue.submit(RenderPass::Opaque, command, glm::length(objects.position(slot.index) - eye));
+        });
+        queue.execute();
+
+        if (gpu_meshing) {
+            glUseProgram(shader_handle);
+            registry.each<ObjectSlot, GpuMeshed, Bounds>([&](Entity, const ObjectSlot& slot, const GpuMeshed& meshed, const Bounds& bounds) {
+                if (occlusion->visible(objects.world()[slot.index], bounds.min, bounds.max)) {
+                    uniforms->push(ObjectConstants{.transform = objects.world()[slot.index]}).bind(1);
+                    voxel_mesher->draw(meshed.mesh);
+                }
+            });
+        }
+        glBindVertexArray(0);
+        glUseProgram(0);
+    }
+
+    // Same scene, with visibility decided by GpuCuller and one indirect multi-draw.
+    void RenderCulledOnGpu() {
+        gpu_culler->begin();
+        registry.each<ObjectSlot, Renderable, Bounds>([&](Entity entity, const ObjectSlot& slot, const Renderable& renderable, const Bounds& bounds) {
+            if (gpu_meshing && registry.has<GpuMeshed>(entity)) {
+                return;
+            }
+            gpu_culler->add(objects.world()[slot.index], bounds.min, bounds.max, block_meshes->range(renderable.mesh));
+        });
+        gpu_culler->cull(occlusion.get());
+
+        glUseProgram(culled_shader_handle);
+        block_meshes->bind();
+        gpu_culler->draw();
+
+        if (gpu_meshing) {
+            glUseProgram(shader_handle);
+            registry.each<ObjectSlot, GpuMeshed>([&](Entity, const ObjectSlot& slot, const GpuMeshed& meshed) {
+                uniforms->push(ObjectConstants{.transform = objects.world()[slot.index]}).bind(1);
+                voxel_mesher->draw(meshed.mesh);
+            });
+        }
+        glBindVertexArray(0);
+        glUseProgram(0);
+    }
+
+    void GeneratePalette() {
+        for (size_t i = 1; i < palette.size(); ++i) {
+            const auto t = static_cast<float>(i) / static_cast<float>(palette.size());
+            palette[i] = glm::u8vec4(glm::vec4(0.35f + 0.4f * t, 0.55f + 0.3f * t, 0.25f, 1.0f) * 255.0f);
+        }
+        voxel_mesher->setPalette(palette);
+        chunk_mesh_seed = Hash64::compute(palette.data(), sizeof(palette), MESH_VERSION);
+
+        /// bevelled swatches, packed into the atlas so the whole palette draws with one texture binding
+        swatches.clear();
+        for (size_t i = 1; i < palette.size(); ++i) {
+            auto swatch = ImageData::create(SWATCH_SIZE, SWATCH_SIZE);
+            swatch.map([color = glm::vec4(palette[i])](const ImageInfo& info, const glm::ivec2& pos, const glm::u8vec4&) {
+                const auto edge = std::min({pos.x, pos.y, static_cast<int>(info.width) - 1 - pos.x, static_cast<int>(info.height) - 1 - pos.y});
+                const auto shade = edge == 0 ? (pos.x == 0 || pos.y == 0 ? 1.25f : 0.6f) : 1.0f;
+                return glm::u8vec4(glm::min(glm::vec4(glm::vec3(color) * shade, color.w), glm::vec4(255.0f)));
+            });
+            if (const auto region = atlas->add(swatch)) {
+                swatches.push_back(*region);
+            }
+        }
+    }
+
+    // Height field in world coordinates, so that neighbouring chunks line up.
+    static void GenerateTerrain(VoxelChunk& chunk, const glm::ivec3& origin) {
+        for (int z = 0; z < VoxelChunk::SIZE; ++z) {
+            for (int x = 0; x < VoxelChunk::SIZE; ++x) {
+                const auto wx = static_cast<float>(origin.x + x);
+                const auto wz = static_cast<float>(origin.z + z);
+                const auto height = 16.0f + 5.0f * glm::sin(wx * 0.3f) + 4.0f * glm::cos(wz * 0.25f) + 4.0f * glm::sin(wx * 0.05f + wz * 0.07f);
+                for (int y = 0; y < static_cast<int>(height); ++y) {
+                    chunk.set(x, y, z, static_cast<uint8_t>(1 + y * 254 / VoxelChunk::SIZE));
+                }
+            }
+        }
+    }
+
+    // Unloads chunks that fell out of range and generates the nearest queued ones, on the thread pool.
+    void StreamChunks() {
+        const auto& eye = registry.get<Transform>(camera_entity);
+
+        chunk_unloads.clear();
+        residency.update(eye.position, -eye.forward(), chunk_unloads);
+        for (const auto& coord : chunk_unloads) {
+            const auto it = chunks.find(coord);
+            UnloadChunk(it->second);
+            chunks.erase(it);
+        }
+
+        chunk_loads.clear();
+        residency.takeLoads(LOADS_PER_FRAME, chunk_loads);
+
+        /// components are emplaced first, so that the workers only look them up
+        std::array<Entity, LOADS_PER_FRAME> created{};
+        for (size_t i = 0; i < chunk_loads.size(); ++i) {
+            const auto& coord = chunk_loads[i];
+            const auto origin = residency.origin(coord);
+
+            const auto entity = registry.create();
+            registry.emplace<ChunkCoord>(entity, coord);
+            registry.emplace<PalettedChunk>(entity);
+            registry.emplace<VoxelLodChain>(entity);
+            registry.emplace<ChunkLod>(entity);
+            registry.emplace<ObjectSlot>(entity, objects.add(glm::vec3(origin.x, -24.0f, origin.y)));
+            registry.emplace<Bounds>(entity, glm::vec3(0.0f), glm::vec3(static_cast<float>(VoxelChunk::SIZE)));
+            chunks.emplace(coord, entity);
+            created[i] = entity;
+        }
+        /// generated flat, then kept only as the LOD chain and the packed copy
+        parallelFor(chunk_loads.size(), [this, &created](size_t i) {
+            const auto entity = created[i];
+            VoxelChunk voxels{};
+            GenerateTerrain(voxels, glm::ivec3(objects.position(registry.get<ObjectSlot>(entity).index)));
+            registry.get<VoxelLodChain>(entity).rebuild(voxels);
+            registry.get<ChunkLod>(entity).full_faces = VoxelMesher::countFaces(voxels.voxels(), VoxelChunk::SIZE);
+            registry.get<PalettedChunk>(entity).assign(voxels.voxels());
+        });
+        for (size_t i = 0; i < chunk_loads.size(); ++i) {
+            if (chunk_loads[i] == ChunkCoord{}) {
+                chunk_entity = created[i];
+                registry.emplace<GpuMeshed>(chunk_entity, voxel_mesher->create());
+                registry.get<PalettedChunk>(chunk_entity).unpack(chunk_build.voxels);
+                voxel_mesher->mesh(chunk_build.voxels, registry.get<GpuMeshed>(chunk_entity).mesh);
+            }
+        }
+
+        streaming.loads = chunk_loads.size();
+        streaming.unloads = chunk_unloads.size();
+        if (residency.queued() > 0) {
+            requestRedraw();
+        }
+    }
+
+    void UnloadChunk(Entity entity) {
+        CancelChunkUpload(entity);
+        if (registry.has<Renderable>(entity)) {
+            block_meshes->destroy(registry.get<Renderable>(entity).mesh);
+        }
+        if (registry.has<GpuMeshed>(entity)) {
+            voxel_mesher->destroy(registry.get<GpuMeshed>(entity).mesh);
+        }
+
+        /// TransformStore::remove moves its last row into the freed one
+        const auto index = registry.get<ObjectSlot>(entity).index;
+        const auto moved = objects.remove(index);
+        if (moved != index) {
+            registry.each<ObjectSlot>([index, moved](Entity, ObjectSlot& slot) {
+                if (slot.index == moved) {
+                    slot.index = index;
+                }
+            });
+        }
+        registry.destroy(entity);
+    }
+
+    // Rebuilds the meshes of chunks whose desired level changed, nearest and in view first, a bounded
+    // number per frame. Meshing runs on the thread pool; uploads stop once the mesh budget is reached
+    // and nothing out of view is left to evict.
+    void MeshChunks() {
+        auto& candidates = chunk_candidates;
+        candidates.clear();
+        registry.each<ChunkCoord, ChunkLod>([&](Entity entity, const ChunkCoord& coord, const ChunkLod& lod) {
+            residency.touch(coord);
+            if (lod.desired != lod.level && !residency.parked(coord) && !registry.has<ChunkUpload>(entity)) {
+                candidates.emplace_back(residency.priority(coord), entity);
+            }
+        });
+
+        /// over budget with nothing idle to evict: whatever was built now would be thrown away
+        auto full = !residency.fits(0) && !residency.victim();
+        const auto count = full ? 0 : std::min(candidates.size(), UPLOADS_PER_FRAME);
+        std::partial_sort(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(count), candidates.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+
+        chunk_builds.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            chunk_builds[i].entity = candidates[i].second;
+            chunk_builds[i].level = registry.get<ChunkLod>(candidates[i].second).desired;
+        }
+        parallelFor(count, [this](size_t i) {
+            BuildChunkMesh(chunk_builds[i], use_mesh_cache);
+        });
+
+        const auto evictions = streaming.evictions;
+        for (auto& build : chunk_builds) {
+            const auto coord = registry.get<ChunkCoord>(build.entity);
+            const auto bytes = MeshBytes(build.meshVertices(), build.meshIndices());
+            while (!residency.fits(bytes)) {
+                const auto victim = residency.victim();
+                if (!victim || *victim == coord) {
+                    break;
+                }
+                EvictChunk(chunks.at(*victim));
+            }
+            if (!residency.fits(bytes)) {
+                full = true;
+                break;
+            }
+            const auto cached = build.cached.has_value(); /// SubmitChunkUpload moves the mapping out
+            if (async_uploads && !build.meshIndices().empty()) {
+                SubmitChunkUpload(build);
+            } else {
+                UploadChunkMesh(build);
+            }
+            streaming.uploads += 1;
+            streaming.cache_hits += cached ? 1 : 0;
+        }
+        if (streaming.evictions != evictions) {
+            block_meshes->trim();
+        }
+
+        /// a full budget frees up only as the camera moves, which redraws anyway
+        if (!full && candidates.size() > streaming.uploads) {
+            requestRedraw();
+        }
+    }
+
+    // GpuMemoryRegistry eviction callback, run between frames: evicts the least recently used chunks
+    // and trims the mesh heap until `excess` bytes are released, or only recently used chunks are left.
+    // The heap shrinks by halves, so this may release more than asked for.
+    size_t EvictChunksOverBudget(size_t excess) {
+        const auto& memory = renderContext->memory;
+        const auto before = memory.total().bytes;
+        while (before - memory.total().bytes < excess) {
+            const auto victim = residency.victim();
+            if (!victim) {
+                break;
+            }
+            EvictChunk(chunks.at(*victim));
+            block_meshes->trim();
+        }
+        return before - memory.total().bytes;
+    }
+
+    void EvictChunk(Entity entity) {
+        CancelChunkUpload(entity);
+        if (registry.has<Renderable>(entity)) {
+            block_meshes->destroy(registry.get<Renderable>(entity).mesh);
+            registry.remove<Renderable>(entity);
+        }
+
+        auto& lod = registry.get<ChunkLod>(entity);
+        lod.level = -1;
+        lod.faces = 0;
+        residency.unmeshed(registry.get<ChunkCoord>(entity), true);
+        streaming.evictions += 1;
+    }
+
+    // Loads the block from the mesh cache, or builds and stores it when its cubes changed.
+    MeshHandle CreateBlockMesh() {
+        const auto key = Hash64::compute(BLOCK_CUBES.data(), sizeof(BLOCK_CUBES), MESH_VERSION);
+        if (const auto cached = mesh_cache.load(key, block_attributes, sizeof(BlockVertex))) {
+            return block_meshes->create(cached->vertices<BlockVertex>(), cached->indices);
+        }
+
+        std::pmr::monotonic_buffer_resource scratch{};
+        BlockRenderContext ctx{&scratch};
+        for (const auto& [x0, y0, z0, x1, y1, z1] : BLOCK_CUBES) {
+            ctx.cube({}, x0, y0, z0, x1, y1, z1);
+        }
+        mesh_cache.store(key, block_attributes, ctx.vertices(), ctx.indices());
+        return block_meshes->create(ctx.vertices(), ctx.indices());
+    }
+
+    // Safe to call from workers for different entities. With `use_cache` the mesh is mapped from the
+    // cache when the voxels at this level were meshed before, and stored there otherwise.
+    void BuildChunkMesh(ChunkBuild& build, bool use_cache) {
+        build.cached.reset();
+        build.vertices.clear();
+        build.indices.clear();
+
+        const auto& packed = registry.get<PalettedChunk>(build.entity);
+        if (packed.empty()) {
+            return;
+        }
+        if (build.level == 0) {
+            packed.unpack(build.voxels);
+        }
+        const auto voxels = registry.get<VoxelLodChain>(build.entity).voxels(build.voxels, build.level);
+
+        const auto key = Hash64::compute(voxels.data(), voxels.size(), chunk_mesh_seed + static_cast<uint64_t>(build.level));
+        if (use_cache && (build.cached = mesh_cache.load(key, block_attributes, sizeof(BlockVertex)))) {
+            return;
+        }
+        VoxelMesher::mesh(voxels, VoxelLodChain::size(build.level), VoxelLodChain::scale(build.level), palette, build.vertices, build.indices);
+        if (use_cache) {
+            mesh_cache.store<BlockVertex>(key, block_attributes, build.vertices, build.indices);
+        }
+    }
+
+    // Replaces the Renderable of the built entity with its new mesh; chunks without faces get none.
+    void UploadChunkMesh(const ChunkBuild& build) {
+        const auto vertices = build.meshVertices();
+        const auto indices = build.meshIndices();
+        const auto mesh = indices.empty() ? MeshHandle{} : block_meshes->create(vertices, indices);
+        SetChunkMesh(build.entity, build.level, mesh, MeshBytes(vertices, indices), indices.size() / 6);
+    }
+
+    // Hands the built mesh to the loader thread, which copies it into a staging buffer; the build's
+    // vectors, or its cache mapping, move into the job.
+    void SubmitChunkUpload(ChunkBuild& build) {
+        const auto vertex_bytes = build.meshVertices().size_bytes();
+        const auto index_bytes = build.meshIndices().size_bytes();
+        const PendingChunkUpload pending {
+            .entity = build.entity,
+            .level = build.level,
+            .vertex_count = static_cast<uint32_t>(build.meshVertices().size()),
+            .index_count = static_cast<uint32_t>(build.meshIndices().size()),
+            .bytes = vertex_bytes + index_bytes
+        };
+
+        BufferUpload upload {
+            .size = static_cast<GLsizeiptr>(vertex_bytes + index_bytes),
+            .category = GpuMemoryCategory::Staging
+        };
+        const auto copy = [vertex_bytes](std::span<std::byte> out, std::span<const BlockVertex> vertices, std::span<const uint32_t> indices) {
+            std::memcpy(out.data(), vertices.data(), vertices.size_bytes());
+            std::memcpy(out.data() + vertex_bytes, indices.data(), indices.size_bytes());
+        };
+        if (build.cached) {
+            upload.fill = [copy, mesh = std::make_shared<MappedMesh>(std::move(*build.cached))](std::span<std::byte> out) {
+                copy(out, mesh->vertices<BlockVertex>(), mesh->indices);
+            };
+            build.cached.reset();
+        } else {
+            upload.fill = [copy, vertices = std::move(build.vertices), indices = std::move(build.indices)](std::span<std::byte> out) {
+                copy(out, vertices, indices);
+            };
+        }
+
+        const auto id = uploader->submit(std::move(upload));
+        chunk_uploads.emplace(id, pending);
+        registry.emplace<ChunkUpload>(build.entity, id);
+        residency.reserve(pending.bytes);
+    }
+
+    // Copies finished staging buffers into the mesh heap on the GPU. Uploads for chunks that were
+    // evicted or unloaded meanwhile are dropped.
+    void ReceiveChunkUploads() {
+        if (!uploader) {
+            return;
+        }
+        uploader->poll([this](const UploadResult& result) {
+            const auto it = chunk_uploads.find(result.id);
+            if (it != chunk_uploads.end()) {
+                const auto pending = it->second;
+                chunk_uploads.erase(it);
+                residency.unreserve(pending.bytes);
+                if (registry.alive(pending.entity)) {
+                    /// a failed upload leaves the chunk at its old level, so MeshChunks builds it again
+                    if (result.handle != GL_NONE) {
+                        const auto index_offset = static_cast<GLintptr>(pending.vertex_count) * static_cast<GLintptr>(sizeof(BlockVertex));
+                        const auto mesh = block_meshes->create(result.handle, pending.vertex_count, index_offset, pending.index_count);
+                        SetChunkMesh(pending.entity, pending.level, mesh, pending.bytes, pending.index_count / 6);
+                    }
+                    registry.remove<ChunkUpload>(pending.entity);
+                }
+            }
+            uploader->release(result);
+        });
+        if (uploader->pending() > 0) {
+            requestRedraw();
+        }
+    }
+
+    // The upload still finishes on the loader thread; ReceiveChunkUploads() then finds no entry for it.
+    void CancelChunkUpload(Entity entity) {
+        if (registry.has<ChunkUpload>(entity)) {
+            const auto it = chunk_uploads.find(registry.get<ChunkUpload>(entity).id);
+            residency.unreserve(it->second.bytes);
+            chunk_uploads.erase(it);
+            registry.remove<ChunkUpload>(entity);
+        }
+    }
+
+    // Replaces the Renderable of `entity`; an invalid handle leaves it without one.
+    void SetChunkMesh(Entity entity, int level, MeshHandle mesh, size_t bytes, size_t faces) {
+        if (registry.has<Renderable>(entity)) {
+            block_meshes->destroy(registry.get<Renderable>(entity).mesh);
+            registry.remove<Renderable>(entity);
+        }
+        if (mesh.valid()) {
+            registry.emplace<Renderable>(entity, mesh);
+        }
+        residency.meshed(registry.get<ChunkCoord>(entity), bytes);
+
+        auto& lod = registry.get<ChunkLod>(entity);
+        lod.level = level;
+        lod.faces = faces;
+    }
+
+    static size_t MeshBytes(std::span<const BlockVertex> vertices, std::span<const uint32_t> indices) {
+        return vertices.size_bytes() + indices.size_bytes();
+    }
+
+    // Meshes the chunk at the origin both ways so that the overlay can compare them: on the CPU,
+    // including the upload into the mesh heap, and with GpuVoxelMesher, timed with a GPU query.
+    void RemeshChunk() {
+        chunk_build.entity = chunk_entity;
+        chunk_build.level = std::max(registry.get<ChunkLod>(chunk_entity).level, 0);
+
+        const auto start = std::chrono::steady_clock::now();
+        BuildChunkMesh(chunk_build, false);
+        UploadChunkMesh(chunk_build);
+        cpu_mesh_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        cpu_mesh_faces = registry.get<ChunkLod>(chunk_entity).faces;
+
+        registry.get<PalettedChunk>(chunk_entity).unpack(chunk_build.voxels);
+        voxel_mesher->mesh(chunk_build.voxels, registry.get<GpuMeshed>(chunk_entity).mesh);
+    }
+
+    VoxelStorageBenchmark BenchmarkVoxelStorage() {
+        static constexpr size_t READS = size_t(1) << 22;
+        static constexpr size_t DECODES = 64;
+
+        VoxelChunk voxels{};
+        GenerateTerrain(voxels, glm::ivec3(-16, -24, -24));
+        const PalettedChunk packed{voxels.voxels()};
+        const std::vector<uint16_t> flat(voxels.voxels().begin(), voxels.voxels().end());
+
+        const auto time = [](auto&& fn) {
+            const auto start = std::chrono::steady_clock::now();
+            fn();
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        };
+        /// the same pseudo-random walk for both, summed so that the reads are not optimised out
+        const auto reads = [](auto&& read) {
+            size_t sum = 0;
+            uint32_t index = 1;
+            for (size_t i = 0; i < READS; ++i) {
+                index = index * 1664525u + 1013904223u;
+                sum += read((index >> 8) % VoxelChunk::VOLUME);
+            }
+            return sum;
+        };
+
+        VoxelStorageBenchmark result{};
+        size_t packed_sum = 0;
+        size_t flat_sum = 0;
+        result.packed_get_ns = time([&] { packed_sum = reads([&packed](size_t i) { return packed.at(i); }); }) * 1000.0 / READS;
+        result.flat_get_ns = time([&] { flat_sum = reads([&flat](size_t i) { return flat[i]; }); }) * 1000.0 / READS;
+        assert(packed_sum == flat_sum && "PalettedChunk reads disagree with the flat copy");
+        result.checksum = packed_sum + flat_sum;
+
+        VoxelChunk decoded{};
+        result.unpack_us = time([&] {
+            for (size_t i = 0; i < DECODES; ++i) {
+                packed.unpack(decoded);
+            }
+        }) / DECODES;
+        result.flat_copy_us = time([&] {
+            for (size_t i = 0; i < DECODES; ++i) {
+                std::transform(flat.begin(), flat.end(), decoded.voxels().begin(), [](uint16_t value) { return static_cast<uint8_t>(value); });
+            }
+        }) / DECODES;
+        return result;
+    }
+
+    TransformBenchmark BenchmarkTransforms() {
+        static constexpr size_t OBJECTS = 100'000;
+        static constexpr size_t UPDATES = 16;
+
+        struct Object {
+            glm::vec3 position;
+            glm::vec2 rotation;
+            float scale;
+        };
+
+        uint32_t seed = 1;
+        const auto random = [&seed](float min, float max) {
+            seed = seed * 1664525u + 1013904223u;
+            return min + (max - min) * static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+        };
+
+        TransformStore store{};
+        std::vector<Object> objects(OBJECTS);
+        std::vector<glm::mat4> world(OBJECTS);
+        std::vector<glm::mat4> mvp(OBJECTS);
+        for (auto& object : objects) {
+            object = {glm::vec3(random(-100, 100), random(-100, 100), random(-100, 100)), glm::vec2(random(-360, 360), random(-90, 90)), random(0.5f, 2.0f)};
+            store.add(object.position, object.rotation, object.scale);
+        }
+
+        const auto time = [](auto&& fn) {
+            const auto start = std::chrono::steady_clock::now();
+            fn();
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        };
+        /// every update turns every object and moves the camera, so nothing is skipped as clean
+        const auto view_projection = [this](size_t update) {
+            return camera.getProjection() * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -static_cast<float>(update + 1)));
+        };
+
+        TransformBenchmark result{};
+        result.objects = OBJECTS;
+        result.store_ms = time([&] {
+            for (size_t update = 0; update < UPDATES; ++update) {
+                for (uint32_t i = 0; i < OBJECTS; ++i) {
+                    store.setRotation(i, objects[i].rotation + static_cast<float>(update));
+                }
+                store.update(view_projection(update));
+            }
+        }) / UPDATES;
+        result.scalar_ms = time([&] {
+            for (size_t update = 0; update < UPDATES; ++update) {
+                const auto vp = view_projection(update);
+                for (size_t i = 0; i < OBJECTS; ++i) {
+                    const auto& object = objects[i];
+                    world[i] = glm::translate(glm::mat4(1.0f), object.position) * Transform::getRotationMatrix(object.rotation + static_cast<float>(update)) * glm::scale(glm::mat4(1.0f), glm::vec3(object.scale));
+                    mvp[i] = vp * world[i];
+                }
+            }
+        }) / UPDATES;
+
+        for (size_t i = 0; i < OBJECTS; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                for (int r = 0; r < 4; ++r) {
+                    result.max_mvp_error = std::max(result.max_mvp_error, std::abs(store.mvp()[i][c][r] - mvp[i][c][r]));
+                }
+            }
+        }
+
+#ifdef TRANSFORM_STORE_SSE2
+        for (float degrees = -720.0f; degrees < 720.0f; degrees += 0.01f) {
+            const auto radians = glm::radians(degrees);
+            __m128 sin, cos;
+            detail::sincos(_mm_set1_ps(radians), sin, cos);
+            result.max_sincos_error = std::max({result.max_sincos_error, std::abs(_mm_cvtss_f32(sin) - std::sin(radians)), std::abs(_mm_cvtss_f32(cos) - std::cos(radians))});
+        }
+#endif
+        return result;
+    }
+
+    ImageExportBenchmark BenchmarkImageExport() {
+        static constexpr glm::u32 SIZE = 2048;
+        static constexpr size_t REPEATS = 4;
+
+        /// smooth gradients with flat and noisy regions, so every encoder has something to find
+        auto image = ImageData::create(SIZE, SIZE);
+        image.map([](const ImageInfo&, const glm::ivec2& p, const glm::u8vec4&) -> glm::u8vec4 {
+            const auto noise = static_cast<uint8_t>((static_cast<uint32_t>(p.x * 73856093 ^ p.y * 19349663) >> 13) & 0x0F);
+            const auto flat = ((p.x / 128 + p.y / 128) & 1) == 0;
+            return {static_cast<uint8_t>(p.x / 8), static_cast<uint8_t>(p.y / 8), flat ? uint8_t{128} : static_cast<uint8_t>(192 + noise), 255};
+        });
+
+        ImageExportBenchmark result{};
+        result.width = SIZE;
+        result.height = SIZE;
+        result.encoders = {
+            MeasureEncoder<BmpEncoder>("BMP", image, REPEATS),
+            MeasureEncoder<QoiEncoder>("QOI", image, REPEATS),
+            MeasureEncoder<PngEncoder>("PNG", image, REPEATS),
+        };
+        return result;
+    }
+
+    template <ImageEncoder Encoder>
+    static ImageExportBenchmark::Encoder MeasureEncoder(const char* name, const ImageData& image, size_t repeats) {
+        const auto raw_mb = static_cast<double>(image.pixels().size_bytes()) * static_cast<double>(repeats) / 1e6;
+
+        size_t bytes = 0;
+        const auto run = [&] {
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < repeats; ++i) {
+                bytes = Encoder::encode(image).size();
+            }
+            return raw_mb / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        double serial_mbps = 0.0;
+        ThreadPool::serial([&] { serial_mbps = run(); });
+        const auto strips_mbps = run();
+        return {name, serial_mbps, strips_mbps, bytes};
+    }
+
+    // Benchmarks run on the main thread when their button is pressed, so that frame takes longer.
+    void DrawBenchmarkPanel() {
+        ImGui::Begin("Benchmarks", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings);
+        if (ImGui::Button("Voxel storage")) {
+            storage_benchmark = BenchmarkVoxelStorage();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Transforms")) {
+            transform_benchmark = BenchmarkTransforms();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Image export")) {
+            export_benchmark = BenchmarkImageExport();
+        }
+        if (storage_benchmark) {
+            ImGui::TextUnformatted(frameArena->format("Voxel reads {:.2f} ns paletted vs {:.2f} ns flat, chunk decode {:.1f} us vs {:.1f} us", storage_benchmark->packed_get_ns, storage_benchmark->flat_get_ns, storage_benchmark->unpack_us, storage_benchmark->flat_copy_us).data());
+        }
+        if (transform_benchmark) {
+            const auto& bench = *transform_benchmark;
+            ImGui::TextUnformatted(frameArena->format("{} transforms: {:.2f} ms TransformStore vs {:.2f} ms per object, max MVP error {:.1e}, sincos error {:.1e}", bench.objects, bench.store_ms, bench.scalar_ms, bench.max_mvp_error, bench.max_sincos_error).data());
+        }
+        if (export_benchmark) {
+            for (const auto& encoder : export_benchmark->encoders) {
+                ImGui::TextUnformatted(frameArena->format("{} {}x{}: {:.0f} MB/s serial, {:.0f} MB/s by strip, {} KiB", encoder.name, export_benchmark->width, export_benchmark->height, encoder.serial_mbps, encoder.strips_mbps, encoder.bytes / 1024).data());
+            }
+        }
+        ImGui::End();
+    }
+
+    // Every swatch samples a view of its atlas layer, so ImGui merges consecutive ones into one draw command.
+    void DrawPalettePanel() {
+        static constexpr size_t COLUMNS = 16;
+
+        ImGui::Begin("Block palette", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings);
+        ImGui::TextUnformatted(frameArena->format("{} swatches in {} atlas layer(s) of {}x{}", swatches.size(), atlas->layers(), atlas->size(), atlas->size()).data());
+        for (size_t i = 0; i < swatches.size(); ++i) {
+            const auto& swatch = swatches[i];
+            if (i % COLUMNS != 0) {
+                ImGui::SameLine(0.0f, 1.0f);
+            }
+            ImGui::Image(
+                (ImTextureID) (intptr_t) atlas->layerView(swatch.layer),
+                ImVec2(static_cast<float>(swatch.size.x), static_cast<float>(swatch.size.y)),
+                ImVec2(swatch.uv.x, swatch.uv.y),
+                ImVec2(swatch.uv.z, swatch.uv.w)
+            );
+        }
+        ImGui::End();
+    }
+
+    void DrawGpuMemoryPanel() {
+        const auto& memory = renderContext->memory;
+        const auto mib = [](size_t bytes) { return static_cast<double>(bytes) / static_cast<double>(1 << 20); };
+
+        ImGui::Begin("GPU Memory", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings);
+        if (ImGui::BeginTable("categories", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("Category");
+            ImGui::TableSetupColumn("Objects");
+            ImGui::TableSetupColumn("MiB");
+            ImGui::TableSetupColumn("Peak MiB");
+            ImGui::TableHeadersRow();
+
+            const auto row = [&](const char* name, const GpuMemoryUsage& usage) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(name);
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(frameArena->format("{}", usage.count).data());
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(frameArena->format("{:.2f}", mib(usage.bytes)).data());
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(frameArena->format("{:.2f}", mib(usage.high_water)).data());
+            };
+
+            for (size_t i = 0; i < GpuMemoryRegistry::CATEGORIES; ++i) {
+                const auto category = static_cast<GpuMemoryCategory>(i);
+                row(GpuMemoryRegistry::name(category), memory.usage(category));
+            }
+            row("Total", memory.total());
+            ImGui::EndTable();
+        }
+        if (ImGui::SliderFloat("Budget (MiB)", &gpu_budget_mib, 0.0f, 2048.0f, "%.0f")) {
+            renderContext->memory.setBudget(static_cast<size_t>(gpu_budget_mib) << 20);
+        }
+        if (memory.budget() != 0) {
+            const auto fraction = static_cast<float>(mib(memory.total().bytes) / mib(memory.budget()));
+            ImGui::ProgressBar(fraction, ImVec2(-1, 0), frameArena->format("{:.1f} / {:.1f} MiB budget", mib(memory.total().bytes), mib(memory.budget())).data());
+        }
+        ImGui::End();
+    }
+
+    glm::mat4 SetupCamera() {
         const auto projection_matrix = camera.getProjection();
-        const auto transform_matrix = transform.getTransformMatrix();
-        const auto camera_matrix = projection_matrix * transform_matrix;
+        const auto& eye = registry.get<Transform>(camera_entity);
+        const auto camera_matrix = projection_matrix * eye.getTransformMatrix();
 
         CameraConstants constants {
             .transform = camera_matrix,
-            .position = glm::vec4(transform.position, 0.0f)
+            .position = glm::vec4(eye.position, 0.0f)
         };
-        std::memcpy(uniforms[frameIndex].pointer, &constants, sizeof(CameraConstants));
-
-        glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniforms[frameIndex].handle);
+        uniforms->push(constants).bind(0);
+        return camera_matrix;
     }
 
     RenderTarget* BeginFrame(const glm::vec4& color) {
-        auto renderTarget = frames[frameIndex].get();
+        if (frames.size() != renderContext->frameSync.depth()) {
+            CreateRenderTargets(viewport.width, viewport.height);
+        }
+
+        auto renderTarget = frames[renderContext->frameSync.index()].get();
         glBindFramebuffer(GL_FRAMEBUFFER, renderTarget->framebuffer);
         glViewport(0, 0, renderTarget->size.x, renderTarget->size.y);
 
@@ -301,23 +1266,13 @@ private:
 
     void EndFrame() {
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        frameIndex = static_cast<int>((static_cast<size_t>(frameIndex) + 1) % frames.size());
-    }
-
-    void CreateUniforms() {
-        uniforms.resize(2);
-        for (auto& uniform : uniforms) {
-            glCreateBuffers(1, &uniform.handle);
-            glNamedBufferStorage(uniform.handle, sizeof(CameraConstants), nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-            uniform.pointer = glMapNamedBufferRange(uniform.handle, 0, sizeof(CameraConstants), GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-        }
     }
 
     void CreateRenderTargets(int width, int height) {
         camera.setAspect(static_cast<float>(width) / static_cast<float>(height));
 
         viewport = {0, 0, width, height};
-        frames.resize(2);
+        frames.resize(renderContext->frameSync.depth());
         for (auto& frame : frames) {
             if (width > 0 && height > 0) {
                 frame = renderContext->createRenderTarget(width, height);
@@ -329,6 +1284,15 @@ private:
 };
 
 int main(int, char**) {
+    /// registered first so it runs last, after function-local statics such as ThreadPool::instance()
+    /// are destroyed; their allocations would otherwise show up as leaks
+    std::atexit([] {
+        if (const auto leaks = AllocationTracker::writeLeakReport("allocations.txt")) {
+            fmt::print("{} allocations still alive at exit, see allocations.txt\n", leaks);
+        }
+    });
+    AllocationTracker::setSampling(64);
+
     App app{"Application", 1280, 720};
     app.run();
     return 0;
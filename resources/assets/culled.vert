@@ -0,0 +1,38 @@
+#version 450
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout (binding = 0) uniform CameraConstants {
+    mat4 transform;
+    vec3 position;
+} constants;
+
+struct Object {
+    mat4 world;
+    vec4 bounds_min;
+    vec4 bounds_max;
+    uint first_index;
+    uint index_count;
+    int base_vertex;
+    uint padding;
+};
+
+layout (std430, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in uint object_index;
+
+layout(location = 0) out struct {
+    vec4 color;
+} v_out;
+
+void main() {
+    gl_Position = constants.transform * objects[object_index].world * vec4(position, 1);
+
+    v_out.color = color;
+}
\ No newline at end of file
@@ -9,7 +9,9 @@ layout (binding = 0) uniform CameraConstants {
     vec3 position;
 } constants;
 
-layout(location = 0) uniform mat4 transform;
+layout (binding = 1) uniform ObjectConstants {
+    mat4 transform;
+} object;
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 color;
@@ -19,7 +21,7 @@ layout(location = 0) out struct {
 } v_out;
 
 void main() {
-    gl_Position = constants.transform * transform * vec4(position, 1);
+    gl_Position = constants.transform * object.transform * vec4(position, 1);
 
     v_out.color = color;
 }
\ No newline at end of file
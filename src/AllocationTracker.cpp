@@ -0,0 +1,309 @@
+#include <AllocationTracker.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define ALLOCATION_TRACKER_BACKTRACE
+#endif
+
+// Every tracked block is preceded by a Header linking it into the list of live allocations. The header
+// sits directly in front of the user pointer; `offset` is the distance back to the start of the block,
+// which grows past sizeof(Header) for over-aligned allocations.
+namespace {
+    struct Header {
+        Header* prev;
+        Header* next;
+        size_t size;
+        uint32_t offset;
+        uint32_t sample; /// index + 1 into samples, 0 when no callstack was recorded
+    };
+
+    static constexpr size_t MAX_FRAMES = 16;
+    static constexpr size_t MAX_SAMPLES = 4096;
+
+    struct Sample {
+        void* frames[MAX_FRAMES];
+        int depth;
+    };
+
+    // Counters of one thread. Written only by their thread, read by any.
+    struct ThreadCounters {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> deallocations{0};
+        std::atomic<uint64_t> bytes_allocated{0};
+        std::atomic<uint64_t> bytes_freed{0};
+        ThreadCounters* next = nullptr;
+    };
+
+    struct State {
+        std::mutex mutex{};
+        Header list{nullptr, nullptr, 0, 0, 0};
+        ThreadCounters* threads = nullptr;
+
+        /// counters of threads that have exited
+        AllocationCounters retired{};
+
+        std::atomic<uint32_t> sampling{0};
+        std::atomic<uint64_t> sequence{0};
+        Sample samples[MAX_SAMPLES]{};
+        uint32_t next_sample = 0;
+    };
+
+    // Never destroyed: allocations are still freed during static destruction.
+    State& state() {
+        alignas(State) static std::byte storage[sizeof(State)];
+        static auto instance = new (storage) State{};
+        return *instance;
+    }
+
+    struct ThreadRegistration {
+        ThreadCounters counters{};
+
+        ThreadRegistration() {
+            auto& s = state();
+            std::lock_guard lock{s.mutex};
+            counters.next = s.threads;
+            s.threads = &counters;
+        }
+
+        ~ThreadRegistration() {
+            auto& s = state();
+            std::lock_guard lock{s.mutex};
+            for (auto link = &s.threads; *link != nullptr; link = &(*link)->next) {
+                if (*link == &counters) {
+                    *link = counters.next;
+                    break;
+                }
+            }
+            s.retired.allocations += counters.allocations.load(std::memory_order_relaxed);
+            s.retired.deallocations += counters.deallocations.load(std::memory_order_relaxed);
+            s.retired.bytes_allocated += counters.bytes_allocated.load(std::memory_order_relaxed);
+            s.retired.bytes_freed += counters.bytes_freed.load(std::memory_order_relaxed);
+            exited = true;
+        }
+
+        static thread_local inline bool exited = false; /// frees from later thread_local destructors go uncounted
+    };
+
+    thread_local ThreadRegistration registration{};
+    thread_local bool reentrant = false; /// set while backtrace() runs, it may allocate on first use
+
+    ThreadCounters* counters() {
+        if (ThreadRegistration::exited) {
+            return nullptr;
+        }
+        return &registration.counters;
+    }
+
+    AllocationCounters load(const ThreadCounters& counters) {
+        return {
+            counters.allocations.load(std::memory_order_relaxed),
+            counters.deallocations.load(std::memory_order_relaxed),
+            counters.bytes_allocated.load(std::memory_order_relaxed),
+            counters.bytes_freed.load(std::memory_order_relaxed)
+        };
+    }
+
+    void add(AllocationCounters& into, const AllocationCounters& value) {
+        into.allocations += value.allocations;
+        into.deallocations += value.deallocations;
+        into.bytes_allocated += value.bytes_allocated;
+        into.bytes_freed += value.bytes_freed;
+    }
+
+    uint32_t sample() {
+#ifdef ALLOCATION_TRACKER_BACKTRACE
+        auto& s = state();
+        const auto every = s.sampling.load(std::memory_order_relaxed);
+        if (every == 0 || reentrant || s.sequence.fetch_add(1, std::memory_order_relaxed) % every != 0) {
+            return 0;
+        }
+
+        Sample captured{};
+        reentrant = true;
+        captured.depth = backtrace(captured.frames, static_cast<int>(MAX_FRAMES));
+        reentrant = false;
+
+        std::lock_guard lock{s.mutex};
+        const auto index = s.next_sample;
+        s.next_sample = (s.next_sample + 1) % MAX_SAMPLES;
+        s.samples[index] = captured;
+        return index + 1;
+#else
+        return 0;
+#endif
+    }
+}
+
+void* AllocationTracker::allocate(size_t size, size_t alignment) {
+    alignment = std::max(alignment, alignof(Header));
+    const auto offset = (sizeof(Header) + alignment - 1) / alignment * alignment;
+
+    auto block = static_cast<std::byte*>(std::aligned_alloc(alignment, (offset + size + alignment - 1) / alignment * alignment));
+    if (block == nullptr) {
+        return nullptr;
+    }
+
+    auto pointer = block + offset;
+    auto header = reinterpret_cast<Header*>(pointer) - 1;
+    header->size = size;
+    header->offset = static_cast<uint32_t>(offset);
+    header->sample = sample();
+
+    if (auto thread = counters()) {
+        thread->allocations.fetch_add(1, std::memory_order_relaxed);
+        thread->bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    auto& s = state();
+    std::lock_guard lock{s.mutex};
+    header->prev = &s.list;
+    header->next = s.list.next;
+    if (s.list.next != nullptr) {
+        s.list.next->prev = header;
+    }
+    s.list.next = header;
+    return pointer;
+}
+
+void AllocationTracker::deallocate(void* pointer) {
+    if (pointer == nullptr) {
+        return;
+    }
+
+    auto header = static_cast<Header*>(pointer) - 1;
+    {
+        auto& s = state();
+        std::lock_guard lock{s.mutex};
+        header->prev->next = header->next;
+        if (header->next != nullptr) {
+            header->next->prev = header->prev;
+        }
+    }
+
+    if (auto thread = counters()) {
+        thread->deallocations.fetch_add(1, std::memory_order_relaxed);
+        thread->bytes_freed.fetch_add(header->size, std::memory_order_relaxed);
+    }
+
+    std::free(static_cast<std::byte*>(pointer) - header->offset);
+}
+
+AllocationCounters AllocationTracker::thread() {
+    if (auto thread = counters()) {
+        return load(*thread);
+    }
+    return {};
+}
+
+AllocationCounters AllocationTracker::total() {
+    auto& s = state();
+    std::lock_guard lock{s.mutex};
+
+    auto result = s.retired;
+    for (auto thread = s.threads; thread != nullptr; thread = thread->next) {
+        add(result, load(*thread));
+    }
+    return result;
+}
+
+void AllocationTracker::setSampling(uint32_t every) {
+    state().sampling.store(every, std::memory_order_relaxed);
+}
+
+size_t AllocationTracker::writeLeakReport(const char* path) {
+    auto file = std::fopen(path, "w");
+    if (file == nullptr) {
+        return 0;
+    }
+
+    auto& s = state();
+    std::lock_guard lock{s.mutex};
+
+    size_t count = 0;
+    size_t bytes = 0;
+    for (auto header = s.list.next; header != nullptr; header = header->next) {
+        count += 1;
+        bytes += header->size;
+        std::fprintf(file, "%zu bytes at %p\n", header->size, static_cast<void*>(header + 1));
+
+#ifdef ALLOCATION_TRACKER_BACKTRACE
+        if (header->sample != 0) {
+            const auto& captured = s.samples[header->sample - 1];
+            std::fflush(file);
+            backtrace_symbols_fd(captured.frames, captured.depth, fileno(file));
+        }
+#endif
+    }
+    std::fprintf(file, "%zu allocations, %zu bytes alive\n", count, bytes);
+    std::fclose(file);
+    return count;
+}
+
+void* operator new(size_t size) {
+    if (auto pointer = AllocationTracker::allocate(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    if (auto pointer = AllocationTracker::allocate(size, static_cast<size_t>(alignment))) {
+        return pointer;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return AllocationTracker::allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return AllocationTracker::allocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    AllocationTracker::deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    AllocationTracker::deallocate(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    AllocationTracker::deallocate(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    AllocationTracker::deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    AllocationTracker::deallocate(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    AllocationTracker::deallocate(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    AllocationTracker::deallocate(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept {
+    AllocationTracker::deallocate(pointer);
+}